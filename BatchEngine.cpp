@@ -0,0 +1,288 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "BatchEngine.h"
+
+#define FULL_ROW ((1u << ARRAY_DX) - 1)
+#define PLAY_COLUMNS (((1u << SCREEN_DX) - 1) << SCREEN_DW)
+
+// One vector holds a value per lane. Comparisons give 0 or -1 (all bits set)
+// per lane, which is used directly as a lane mask with & and |.
+typedef uint32_t lanes __attribute__((vector_size(BATCH_LANES * sizeof(uint32_t))));
+typedef int32_t ilanes __attribute__((vector_size(BATCH_LANES * sizeof(int32_t))));
+
+static inline lanes load(const uint32_t *p) { lanes v; memcpy(&v, p, sizeof(v)); return v; }
+static inline void store(uint32_t *p, lanes v) { memcpy(p, &v, sizeof(v)); }
+static inline ilanes load(const int *p) { ilanes v; memcpy(&v, p, sizeof(v)); return v; }
+static inline void store(int *p, ilanes v) { memcpy(p, &v, sizeof(v)); }
+
+static inline bool anyLane(lanes v) {
+    uint32_t all = 0;
+    for (int l = 0; l < BATCH_LANES; l++)
+        all |= v[l];
+    return all != 0;
+}
+
+static inline int minLane(ilanes v) {
+    int m = v[0];
+    for (int l = 1; l < BATCH_LANES; l++)
+        m = (v[l] < m) ? v[l] : m;
+    return m;
+}
+
+static inline int maxLane(ilanes v) {
+    int m = v[0];
+    for (int l = 1; l < BATCH_LANES; l++)
+        m = (v[l] > m) ? v[l] : m;
+    return m;
+}
+
+// 1 where the key is c, 0 elsewhere
+static inline ilanes isKey(ilanes k, char c) { return (ilanes) (k == c) & 1; }
+
+// The current block of every lane, already shifted to its column.
+struct LaneBlock {
+    lanes rows[4];
+    lanes box[4];
+    ilanes dy;
+};
+
+static void laneBlock(const BatchBlock (*blocks)[MAX_BLK_DEGREES], const int *type, const int *degree,
+                      const int *left, LaneBlock *b) {
+    for (int l = 0; l < BATCH_LANES; l++) {
+        const BatchBlock &blk = blocks[type[l]][degree[l]];
+        for (int r = 0; r < 4; r++) {
+            b->rows[r][l] = blk.rows[r] << left[l];
+            b->box[r][l] = blk.box[r] << left[l];
+        }
+        b->dy[l] = blk.dy;
+    }
+}
+
+// Row r of the block for the lanes whose block row sits on board row y
+static inline lanes rowAt(const lanes *rows, ilanes r) {
+    return ((lanes) (r == 0) & rows[0]) | ((lanes) (r == 1) & rows[1]) |
+           ((lanes) (r == 2) & rows[2]) | ((lanes) (r == 3) & rows[3]);
+}
+
+// Non-zero lanes collide at tops t: a block cell on a filled cell, or any 2+
+// cell inside the bounding box (anyGreaterThan(1) on clip + block). Board
+// rows are swept over the lanes' range of tops, so each row is one load for
+// all lanes instead of a gather per lane.
+static lanes collideLanes(const uint32_t *occ, const uint32_t *over, int stride, ilanes t, const LaneBlock &b) {
+    lanes hit = {};
+    int last = maxLane(t) + 4;
+    for (int y = minLane(t); y < last; y++) {
+        ilanes r = y - t;
+        int row = (y < ARRAY_DY) ? y : ARRAY_DY - 1;   // rows past the box have empty masks
+        hit |= (load(occ + row * stride) & rowAt(b.rows, r)) | (load(over + row * stride) & rowAt(b.box, r));
+    }
+    return hit;
+}
+
+BatchEngine::BatchEngine(int nGames, const unsigned int *seeds) {
+    this->nGames = nGames;
+    nLanes = (nGames + BATCH_LANES - 1) / BATCH_LANES * BATCH_LANES;
+
+    for (int i = 0; i < MAX_BLK_TYPES; i++) {
+        for (int j = 0; j < MAX_BLK_DEGREES; j++) {
+            int *arr = setOfBlockArrays[i * MAX_BLK_DEGREES + j];
+            int side = getSideLength(arr);
+            BatchBlock &b = blocks[i][j];
+            b.dy = side;
+            b.dx = side;
+            for (int y = 0; y < 4; y++) {
+                b.rows[y] = 0;
+                b.box[y] = (y < side) ? (1u << side) - 1 : 0;
+                for (int x = 0; (y < side) && (x < side); x++)
+                    if (arr[y * side + x] != 0)
+                        b.rows[y] |= 1u << x;
+            }
+        }
+    }
+
+    occ = new uint32_t[ARRAY_DY * nLanes];
+    over = new uint32_t[ARRAY_DY * nLanes];
+    top = new int[nLanes];
+    left = new int[nLanes];
+    blockType = new int[nLanes];
+    idxBlockDegree = new int[nLanes];
+    score = new int[nLanes];
+    nBlocks = new int[nLanes];
+    rngSeed = new unsigned int[nLanes];
+    newBlockNeeded = new uint32_t[nLanes];
+    gameOver = new uint32_t[nLanes];
+    keys = new char[nLanes];
+
+    for (int y = 0; y < ARRAY_DY; y++) {
+        uint32_t row = 0;
+        for (int x = 0; x < ARRAY_DX; x++)
+            if (arrayScreen[y][x] != 0)
+                row |= 1u << x;
+        for (int g = 0; g < nLanes; g++) {
+            occ[y * nLanes + g] = row;
+            over[y * nLanes + g] = 0;
+        }
+    }
+    // the same start as the Tetris constructor; padding lanes are over already
+    for (int g = 0; g < nLanes; g++) {
+        rngSeed[g] = (g < nGames) ? seeds[g] : 0;
+        top[g] = INIT_TOP;
+        left[g] = INIT_LEFT;
+        idxBlockDegree[g] = 0;
+        blockType[g] = (g < nGames) ? rand_r(&rngSeed[g]) % MAX_BLK_TYPES : 0;
+        score[g] = 0;
+        nBlocks[g] = 1;
+        newBlockNeeded[g] = 0;
+        gameOver[g] = (g >= nGames);
+        keys[g] = 0;
+    }
+}
+
+BatchEngine::~BatchEngine() {
+    delete[] occ;
+    delete[] over;
+    delete[] top;
+    delete[] left;
+    delete[] blockType;
+    delete[] idxBlockDegree;
+    delete[] score;
+    delete[] nBlocks;
+    delete[] rngSeed;
+    delete[] newBlockNeeded;
+    delete[] gameOver;
+    delete[] keys;
+}
+
+// lockBlock() for lanes g0 .. g0 + BATCH_LANES - 1: merge, deleteFullLines,
+// checkIsTouchedTop, next block
+void BatchEngine::lockBlocks(int g0) {
+    uint32_t *o = occ + g0;
+    uint32_t *v = over + g0;
+    lanes active = (lanes) ((load(newBlockNeeded + g0) != 0) & (load(gameOver + g0) == 0));
+    if (!anyLane(active))
+        return;
+    ilanes t = load(top + g0);
+    LaneBlock b;
+    laneBlock(blocks, blockType + g0, idxBlockDegree + g0, left + g0, &b);
+
+    // merge: iScreen = oScreen
+    int last = maxLane(t) + 4;
+    for (int y = minLane(t); y < last; y++) {
+        int row = (y < ARRAY_DY) ? y : ARRAY_DY - 1;
+        lanes m = active & rowAt(b.rows, y - t);
+        lanes cells = load(o + row * nLanes);
+        store(v + row * nLanes, load(v + row * nLanes) | (cells & m));
+        store(o + row * nLanes, cells | m);
+    }
+
+    // deleteFullLines: rows top .. top + dy - 1 above the floor, in order
+    ilanes s = load(score + g0);
+    for (int i = 0; i < SCREEN_DY; i++) {
+        lanes moving = active & (lanes) (i >= t) & (lanes) (i < t + b.dy) & (lanes) (load(o + i * nLanes) == FULL_ROW);
+        if (!anyLane(moving))
+            continue;
+        s += (ilanes) moving & 1;
+        // rows 0 .. i-1 move down by one; row 0 stays as it was
+        for (int y = i; y > 0; y--) {
+            uint32_t *oy = o + y * nLanes;
+            uint32_t *vy = v + y * nLanes;
+            store(oy, (load(oy - nLanes) & moving) | (load(oy) & ~moving));
+            store(vy, (load(vy - nLanes) & moving) | (load(vy) & ~moving));
+        }
+    }
+    store(score + g0, s);
+
+    // checkIsTouchedTop looks for cells equal to 1 in the top row
+    lanes touched = (lanes) ((load(o) & ~load(v) & PLAY_COLUMNS) != 0);
+    store(gameOver + g0, load(gameOver + g0) | (active & touched & 1));
+    active &= ~touched;
+
+    // rand_r is sequential per game, so the next block is drawn lane by lane
+    for (int l = 0; l < BATCH_LANES; l++) {
+        if (!active[l]) continue;
+        int g = g0 + l;
+        top[g] = INIT_TOP;
+        left[g] = INIT_LEFT;
+        blockType[g] = rand_r(&rngSeed[g]) % MAX_BLK_TYPES;
+        nBlocks[g]++;
+        newBlockNeeded[g] = 0;
+    }
+}
+
+// handleKey() for lanes g0 .. g0 + BATCH_LANES - 1: move, hard drop, probe and roll back
+void BatchEngine::handleKeys(int g0) {
+    ilanes k;
+    for (int l = 0; l < BATCH_LANES; l++)
+        k[l] = keys[g0 + l];
+    ilanes on = (ilanes) (load(gameOver + g0) == 0);
+    ilanes dx = isKey(k, 'd') - isKey(k, 'a');
+    ilanes turn = isKey(k, 'p') - isKey(k, 'l');
+    ilanes t = load(top + g0) + (on & isKey(k, 's'));
+    ilanes l = load(left + g0) + (on & dx);
+    ilanes degree = (load(idxBlockDegree + g0) + (on & turn) + MAX_BLK_DEGREES) % MAX_BLK_DEGREES;
+    store(left + g0, l);
+    store(idxBlockDegree + g0, degree);
+
+    LaneBlock b;
+    laneBlock(blocks, blockType + g0, idxBlockDegree + g0, left + g0, &b);
+    const uint32_t *o = occ + g0;
+    const uint32_t *v = over + g0;
+
+    // hard drop: the dropping lanes fall one row per round until they collide
+    ilanes moving = on & (ilanes) (k == ' ');
+    while (anyLane((lanes) moving)) {
+        t += moving & 1;
+        moving &= (ilanes) (collideLanes(o, v, nLanes, t, b) == 0);
+    }
+
+    ilanes hit = on & (ilanes) (collideLanes(o, v, nLanes, t, b) != 0);
+    ilanes land = hit & (ilanes) ((k == 's') | (k == ' '));
+    store(left + g0, l - (hit & dx));
+    store(top + g0, t - (land & 1));
+    store(newBlockNeeded + g0, load(newBlockNeeded + g0) | ((lanes) land & 1));
+    store(idxBlockDegree + g0, (degree - (hit & turn) + MAX_BLK_DEGREES) % MAX_BLK_DEGREES);
+}
+
+// Tetris::step() for every game; games that are over stay as they are
+void BatchEngine::step(const char *keys) {
+    memcpy(this->keys, keys, nGames);
+    for (int g0 = 0; g0 < nLanes; g0 += BATCH_LANES) {
+        lockBlocks(g0);
+        handleKeys(g0);
+    }
+}
+
+int BatchEngine::get_nGames() const { return nGames; }
+
+int BatchEngine::get_top(int g) const { return top[g]; }
+
+int BatchEngine::get_left(int g) const { return left[g]; }
+
+int BatchEngine::get_blockType(int g) const { return blockType[g]; }
+
+int BatchEngine::get_idxBlockDegree(int g) const { return idxBlockDegree[g]; }
+
+int BatchEngine::get_score(int g) const { return score[g]; }
+
+int BatchEngine::get_nBlocks(int g) const { return nBlocks[g]; }
+
+bool BatchEngine::isNewBlockNeeded(int g) const { return newBlockNeeded[g]; }
+
+bool BatchEngine::isGameOver(int g) const { return gameOver[g]; }
+
+unsigned int BatchEngine::get_rngSeed(int g) const { return rngSeed[g]; }
+
+int BatchEngine::cell(int g, int y, int x) const {
+    return ((occ[y * nLanes + g] >> x) & 1) + ((over[y * nLanes + g] >> x) & 1);
+}
+
+int BatchEngine::composedCell(int g, int y, int x) const {
+    int value = cell(g, y, x);
+    const BatchBlock &b = blocks[blockType[g]][idxBlockDegree[g]];
+    int r = y - top[g];
+    int c = x - left[g];
+    if ((r >= 0) && (r < b.dy) && (c >= 0) && (c < b.dx))
+        value += (b.rows[r] >> c) & 1;
+    return (value > 2) ? 2 : value;
+}
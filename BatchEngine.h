@@ -0,0 +1,64 @@
+#pragma once
+#include <stdint.h>
+#include "Matrix.h"
+#include "Tetris.h"
+
+// Many games stepped together, structure-of-arrays.
+// Row y of every board sits next to row y of the other boards, one bit per
+// column (walls included, like arrayScreen), and the block state lives in
+// parallel arrays. step() applies one key per game as a sequence of passes
+// over all games; each pass works on BATCH_LANES games at a time as one
+// vector (GCC vector extensions), so the same operation runs on a block of
+// lanes instead of board by board. Games are padded to a whole number of
+// vectors with lanes that are over from the start.
+//
+// Cells are kept as two bit planes because the rules can tell three values
+// apart: 0 (empty), 1 (block or wall) and 2+ (a block merged on top of
+// another, which collides with anything in its bounding box and does not
+// count for checkIsTouchedTop).
+
+#define BATCH_LANES 8
+
+struct BatchBlock {
+    int dy;
+    int dx;
+    uint32_t rows[4];   // occupied cells, bit x = column x
+    uint32_t box[4];    // the whole bounding box row, for 2+ cells
+};
+
+class BatchEngine {
+private:
+    int nGames;
+    int nLanes;         // nGames rounded up to whole vectors, the row stride
+    BatchBlock blocks[MAX_BLK_TYPES][MAX_BLK_DEGREES];
+    uint32_t *occ;      // [ARRAY_DY][nLanes] cell != 0
+    uint32_t *over;     // [ARRAY_DY][nLanes] cell >= 2
+    int *top;
+    int *left;
+    int *blockType;
+    int *idxBlockDegree;
+    int *score;
+    int *nBlocks;
+    unsigned int *rngSeed;
+    uint32_t *newBlockNeeded;   // 0 or 1
+    uint32_t *gameOver;         // 0 or 1
+    char *keys;                 // this step's keys, padded to nLanes
+    void lockBlocks(int g0);
+    void handleKeys(int g0);
+public:
+    BatchEngine(int nGames, const unsigned int *seeds);
+    ~BatchEngine();
+    void step(const char *keys);
+    int get_nGames() const;
+    int get_top(int g) const;
+    int get_left(int g) const;
+    int get_blockType(int g) const;
+    int get_idxBlockDegree(int g) const;
+    int get_score(int g) const;
+    int get_nBlocks(int g) const;
+    bool isNewBlockNeeded(int g) const;
+    bool isGameOver(int g) const;
+    unsigned int get_rngSeed(int g) const;
+    int cell(int g, int y, int x) const;          // iScreen value, 2 meaning 2 or more
+    int composedCell(int g, int y, int x) const;  // oScreen value, same clamping
+};
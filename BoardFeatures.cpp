@@ -0,0 +1,159 @@
+#include <stdlib.h>
+#include "BoardFeatures.h"
+
+#define LOW_BITS(n) ((1u << (n)) - 1)
+#define FULL_ROW LOW_BITS(SCREEN_DX)
+
+BoardFeatures::BoardFeatures() {
+    for (int c = 0; c < SCREEN_DX; c++)
+        cols[c] = 0;
+    for (int y = 0; y < SCREEN_DY; y++)
+        rows[y] = 0;
+    recomputeAll();
+}
+
+BoardFeatures::BoardFeatures(const Matrix *screen) { reset(screen); }
+
+void BoardFeatures::reset(const Matrix *screen) {
+    int **array = screen->get_array();
+    for (int c = 0; c < SCREEN_DX; c++)
+        cols[c] = 0;
+    for (int y = 0; y < SCREEN_DY; y++) {
+        rows[y] = 0;
+        for (int c = 0; c < SCREEN_DX; c++) {
+            if (array[y][SCREEN_DW + c] == 0) continue;
+            rows[y] |= 1u << c;
+            cols[c] |= 1u << y;
+        }
+    }
+    recomputeAll();
+}
+
+void BoardFeatures::recomputeAll() {
+    height = holes = bumpiness = totalColTransitions = wellSum = 0;
+    for (int c = 0; c < SCREEN_DX; c++) {
+        heights[c] = colHoles[c] = colTransitions[c] = wells[c] = 0;
+    }
+    updateColumns(0, SCREEN_DX - 1);
+    totalRowTransitions = 0;
+    filledRows = 0;
+    for (int y = 0; y < SCREEN_DY; y++) {
+        rowTransitions[y] = 0;
+        updateRow(y);
+    }
+}
+
+// Columns c0..c1 have new masks: re-derive them, then the bumpiness and the
+// wells they share with their neighbours.
+void BoardFeatures::updateColumns(int c0, int c1) {
+    int w0 = (c0 > 0) ? c0 - 1 : 0;
+    int w1 = (c1 < SCREEN_DX - 1) ? c1 + 1 : SCREEN_DX - 1;
+    for (int c = w0 + 1; c <= w1; c++)
+        bumpiness -= abs(heights[c] - heights[c - 1]);
+    for (int c = w0; c <= w1; c++)
+        wellSum -= wells[c];
+
+    for (int c = c0; c <= c1; c++) {
+        height -= heights[c];
+        holes -= colHoles[c];
+        totalColTransitions -= colTransitions[c];
+
+        uint32_t col = cols[c];
+        int topY = col ? __builtin_ctz(col) : SCREEN_DY;
+        heights[c] = SCREEN_DY - topY;
+        colHoles[c] = heights[c] - __builtin_popcount(col);
+        // neighbouring cells that differ, plus an empty bottom cell against the floor
+        colTransitions[c] = __builtin_popcount((col ^ (col >> 1)) & LOW_BITS(SCREEN_DY - 1)) +
+                            (((col >> (SCREEN_DY - 1)) & 1) ? 0 : 1);
+
+        height += heights[c];
+        holes += colHoles[c];
+        totalColTransitions += colTransitions[c];
+    }
+
+    for (int c = w0 + 1; c <= w1; c++)
+        bumpiness += abs(heights[c] - heights[c - 1]);
+    for (int c = w0; c <= w1; c++) {
+        int leftHeight = (c > 0) ? heights[c - 1] : SCREEN_DY;
+        int rightHeight = (c < SCREEN_DX - 1) ? heights[c + 1] : SCREEN_DY;
+        int depth = min(leftHeight, rightHeight) - heights[c];
+        wells[c] = (depth > 0) ? depth : 0;
+        wellSum += wells[c];
+    }
+    maxWell = 0;
+    for (int c = 0; c < SCREEN_DX; c++)
+        maxWell = max(maxWell, wells[c]);
+}
+
+void BoardFeatures::updateRow(int y) {
+    totalRowTransitions -= rowTransitions[y];
+    // the row between its two walls: bit 0 and bit SCREEN_DX + 1 are filled
+    uint32_t r = 1u | (rows[y] << 1) | (1u << (SCREEN_DX + 1));
+    rowTransitions[y] = __builtin_popcount((r ^ (r >> 1)) & LOW_BITS(SCREEN_DX + 1));
+    totalRowTransitions += rowTransitions[y];
+    filledRows = rows[y] ? (filledRows | (1u << y)) : (filledRows & ~(1u << y));
+}
+
+// Same rows and the same shifting as deleteFullLines(): rows top ..
+// top + dy - 1 above the floor, in order; rows above a full one move down
+// by one and row 0 keeps its cells.
+int BoardFeatures::lock(const SparsePiece &piece, int top, int left) {
+    const PieceCell *cells = piece.get_cells();
+    int c0 = SCREEN_DX, c1 = -1;
+    for (int i = 0; i < piece.get_nCells(); i++) {
+        int y = top + cells[i].dy;
+        int c = left + cells[i].dx - SCREEN_DW;
+        if ((y < 0) || (y >= SCREEN_DY) || (c < 0) || (c >= SCREEN_DX))
+            continue;   // in the walls or the floor, which are not tracked
+        rows[y] |= 1u << c;
+        cols[c] |= 1u << y;
+        c0 = min(c0, c);
+        c1 = max(c1, c);
+    }
+
+    int lines = 0;
+    for (int i = top; (i < top + piece.get_dy()) && (i < SCREEN_DY); i++) {
+        if ((i < 0) || (rows[i] != FULL_ROW)) continue;
+        lines++;
+        if (i == 0) continue;
+        for (int y = i; y > 0; y--)
+            rows[y] = rows[y - 1];
+        uint32_t below = ~LOW_BITS(i + 1);
+        for (int c = 0; c < SCREEN_DX; c++)
+            cols[c] = (cols[c] & below) | ((cols[c] & LOW_BITS(i)) << 1) | (cols[c] & 1u);
+    }
+
+    if (lines > 0) {
+        updateColumns(0, SCREEN_DX - 1);
+        for (int y = 0; y < SCREEN_DY; y++)
+            updateRow(y);
+    } else if (c1 >= 0) {
+        updateColumns(c0, c1);
+        for (int i = 0; i < piece.get_nCells(); i++) {
+            int y = top + cells[i].dy;
+            if ((y >= 0) && (y < SCREEN_DY))
+                updateRow(y);
+        }
+    }
+    return lines;
+}
+
+bool BoardFeatures::isFilled(int y, int c) const { return (rows[y] >> c) & 1; }
+
+int BoardFeatures::get_columnHeight(int c) const { return heights[c]; }
+
+int BoardFeatures::get_height() const { return height; }
+
+int BoardFeatures::get_maxHeight() const { return filledRows ? SCREEN_DY - __builtin_ctz(filledRows) : 0; }
+
+int BoardFeatures::get_holes() const { return holes; }
+
+int BoardFeatures::get_bumpiness() const { return bumpiness; }
+
+int BoardFeatures::get_rowTransitions() const { return totalRowTransitions; }
+
+int BoardFeatures::get_colTransitions() const { return totalColTransitions; }
+
+int BoardFeatures::get_wellSum() const { return wellSum; }
+
+int BoardFeatures::get_maxWell() const { return maxWell; }
@@ -0,0 +1,58 @@
+#pragma once
+#include <stdint.h>
+#include "Matrix.h"
+#include "Tetris.h"
+#include "SparsePiece.h"
+
+// Board evaluation features, kept up to date instead of rescanned.
+// The playfield is held as bit masks, one per column (bit y = row y, top
+// row 0) and one per row (bit c = playfield column c); a cell counts as
+// filled when it is not 0. lock() sets the piece's bits, re-derives the
+// columns it touched with ctz/popcount and patches the totals; a line clear
+// shifts the masks like deleteFullLines() and re-derives every column,
+// again from the masks alone. All get_ functions are constant time.
+//
+//   height           sum of column heights
+//   holes            empty cells under the top of their column
+//   bumpiness        sum of |height difference| of neighbouring columns
+//   row transitions  filled/empty changes along each row, walls filled
+//   col transitions  filled/empty changes down each column, floor filled
+//   wells            per column, how far it lies below its lower neighbour
+//                    (walls as high as the field); sum and deepest
+
+class BoardFeatures {
+private:
+    uint32_t cols[SCREEN_DX];
+    uint32_t rows[SCREEN_DY];
+    uint32_t filledRows;        // bit y: row y has a filled cell
+    int heights[SCREEN_DX];
+    int colHoles[SCREEN_DX];
+    int colTransitions[SCREEN_DX];
+    int rowTransitions[SCREEN_DY];
+    int wells[SCREEN_DX];
+    int height;
+    int holes;
+    int bumpiness;
+    int totalRowTransitions;
+    int totalColTransitions;
+    int wellSum;
+    int maxWell;
+    void updateColumns(int c0, int c1);
+    void updateRow(int y);
+    void recomputeAll();
+public:
+    BoardFeatures();
+    BoardFeatures(const Matrix *screen);
+    void reset(const Matrix *screen);
+    int lock(const SparsePiece &piece, int top, int left);   // lines cleared
+    bool isFilled(int y, int c) const;
+    int get_columnHeight(int c) const;
+    int get_height() const;
+    int get_maxHeight() const;
+    int get_holes() const;
+    int get_bumpiness() const;
+    int get_rowTransitions() const;
+    int get_colTransitions() const;
+    int get_wellSum() const;
+    int get_maxWell() const;
+};
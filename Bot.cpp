@@ -0,0 +1,140 @@
+#include <float.h>
+#include <stdlib.h>
+
+#include "Bot.h"
+
+const char *botFeatureNames[BOT_NFEATURES] = {
+    "lines", "height", "holes", "bumpiness", "maxHeight"
+};
+
+Bot::Bot(const double *weights) {
+    for (int i = 0; i < BOT_NFEATURES; i++)
+        this->weights[i] = weights[i];
+}
+
+// Features of the board after the piece lands at (top, left); false if the game would be over.
+// base holds the features of iScreen and is not changed.
+bool Bot::evaluate(Matrix *iScreen, const BoardFeatures &base, const SparsePiece &piece, int top, int left,
+                   double features[BOT_NFEATURES]) {
+    BoardFeatures after = base;
+    int lines = after.lock(piece, top, left);
+
+    // checkIsTouchedTop: row 0 never moves when lines are deleted,
+    // so it is row 0 of iScreen plus the cells the piece puts there
+    int row0[SCREEN_DX];
+    int *array = iScreen->get_array()[0];
+    for (int c = 0; c < SCREEN_DX; c++)
+        row0[c] = array[SCREEN_DW + c];
+    const PieceCell *cells = piece.get_cells();
+    for (int i = 0; i < piece.get_nCells(); i++) {
+        int c = left + cells[i].dx - SCREEN_DW;
+        if ((top + cells[i].dy == 0) && (c >= 0) && (c < SCREEN_DX))
+            row0[c] += 1;
+    }
+    for (int c = 0; c < SCREEN_DX; c++)
+        if (row0[c] == 1)
+            return false;
+
+    features[BOT_LINES] = lines;
+    features[BOT_HEIGHT] = after.get_height();
+    features[BOT_HOLES] = after.get_holes();
+    features[BOT_BUMPINESS] = after.get_bumpiness();
+    features[BOT_MAX_HEIGHT] = after.get_maxHeight();
+    return true;
+}
+
+BotMove Bot::choose(Matrix *setOfBlockObjects[MAX_BLK_TYPES][MAX_BLK_DEGREES],
+                    SparsePiece pieces[MAX_BLK_TYPES][MAX_BLK_DEGREES], const Tetris &game) const {
+    BotMove best = { false, game.get_idxBlockDegree(), game.get_left(), -DBL_MAX };
+    Matrix *iScreen = game.get_iScreen();
+    int top = game.get_top();
+    int type = game.get_blockType();
+
+    // the sparse test only sees the block's own cells; merged 2+ cells need the dense one
+    bool sparse = !iScreen->anyGreaterThan(1);
+    BoardFeatures base(iScreen);
+    auto hits = [&](int degree, int t, int l) {
+        if (sparse)
+            return pieces[type][degree].collides(iScreen, t, l);
+        return collides(iScreen, setOfBlockObjects[type][degree], t, l);
+    };
+
+    // 'p' presses from the current rotation; a press that collides is undone and stops here
+    int degree = game.get_idxBlockDegree();
+    for (int r = 0; r < MAX_BLK_DEGREES; r++) {
+        if (r > 0) {
+            degree = (degree + 1) % MAX_BLK_DEGREES;
+            if (hits(degree, top, game.get_left()))
+                break;
+        }
+
+        // columns reachable with 'a' / 'd' before the first collision
+        int minLeft = game.get_left(), maxLeft = game.get_left();
+        while (!hits(degree, top, minLeft - 1))
+            minLeft--;
+        while (!hits(degree, top, maxLeft + 1))
+            maxLeft++;
+
+        for (int left = minLeft; left <= maxLeft; left++) {
+            int landing = top;
+            while (!hits(degree, landing + 1, left))
+                landing++;
+
+            double features[BOT_NFEATURES];
+            double value = -DBL_MAX / 2;   // still better than nothing
+            if (evaluate(iScreen, base, pieces[type][degree], landing, left, features)) {
+                value = 0;
+                for (int i = 0; i < BOT_NFEATURES; i++)
+                    value += weights[i] * features[i];
+            }
+            if (!best.valid || (value > best.value)) {
+                best.valid = true;
+                best.degree = degree;
+                best.left = left;
+                best.value = value;
+            }
+        }
+    }
+    return best;
+}
+
+int Bot::plan(const Tetris &game, const BotMove &move, char *keys, int maxKeys) const {
+    int n = 0;
+    if (move.valid) {
+        int turns = (move.degree - game.get_idxBlockDegree() + MAX_BLK_DEGREES) % MAX_BLK_DEGREES;
+        for (int i = 0; (i < turns) && (n < maxKeys - 2); i++)
+            keys[n++] = 'p';
+        for (int left = game.get_left(); (left > move.left) && (n < maxKeys - 2); left--)
+            keys[n++] = 'a';
+        for (int left = game.get_left(); (left < move.left) && (n < maxKeys - 2); left++)
+            keys[n++] = 'd';
+    }
+    keys[n++] = ' ';
+    keys[n++] = 'w';   // any key merges the landed block and brings the next one
+    return n;
+}
+
+int playGame(Matrix *setOfBlockObjects[MAX_BLK_TYPES][MAX_BLK_DEGREES], const Bot &bot,
+             unsigned int seed, int maxBlocks, int *nBlocks,
+             const std::function<void(const Tetris &)> &onStep) {
+    Tetris game(setOfBlockObjects, seed, false);
+    SparsePiece pieces[MAX_BLK_TYPES][MAX_BLK_DEGREES];
+    createSparsePieces(setOfBlockObjects, pieces);
+    char keys[64];
+
+    if (onStep)
+        onStep(game);
+    while (!game.isGameOver() && (game.get_nBlocks() <= maxBlocks)) {
+        BotMove move = bot.choose(setOfBlockObjects, pieces, game);
+        int n = bot.plan(game, move, keys, sizeof(keys));
+        for (int i = 0; i < n; i++) {
+            if (!game.step(keys[i]))
+                break;
+            if (onStep)
+                onStep(game);
+        }
+    }
+    if (nBlocks != NULL)
+        *nBlocks = game.get_nBlocks();
+    return game.get_score();
+}
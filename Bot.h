@@ -0,0 +1,47 @@
+#pragma once
+#include <functional>
+#include "Matrix.h"
+#include "Tetris.h"
+#include "SparsePiece.h"
+#include "BoardFeatures.h"
+
+// Greedy one-block bot for self-play.
+// For every rotation and column the block can reach from where it is, the
+// bot drops it, scores the resulting board with a weighted sum of features,
+// and plays the best placement through the same keys a player would press.
+
+enum BotFeature {
+    BOT_LINES,        // lines cleared by the placement
+    BOT_HEIGHT,       // aggregate column height
+    BOT_HOLES,        // empty cells under the top of their column
+    BOT_BUMPINESS,    // sum of height differences between neighbouring columns
+    BOT_MAX_HEIGHT,
+    BOT_NFEATURES
+};
+
+extern const char *botFeatureNames[BOT_NFEATURES];
+
+struct BotMove {
+    bool valid;
+    int degree;
+    int left;
+    double value;
+};
+
+class Bot {
+private:
+    double weights[BOT_NFEATURES];
+public:
+    Bot(const double *weights);
+    static bool evaluate(Matrix *iScreen, const BoardFeatures &base, const SparsePiece &piece, int top, int left,
+                         double features[BOT_NFEATURES]);
+    BotMove choose(Matrix *setOfBlockObjects[MAX_BLK_TYPES][MAX_BLK_DEGREES],
+                   SparsePiece pieces[MAX_BLK_TYPES][MAX_BLK_DEGREES], const Tetris &game) const;
+    int plan(const Tetris &game, const BotMove &move, char *keys, int maxKeys) const;
+};
+
+// Plays one seeded game to the end (or maxBlocks blocks) and returns the lines cleared.
+// onStep, if given, sees the starting position and the game after every key.
+int playGame(Matrix *setOfBlockObjects[MAX_BLK_TYPES][MAX_BLK_DEGREES], const Bot &bot,
+             unsigned int seed, int maxBlocks, int *nBlocks,
+             const std::function<void(const Tetris &)> &onStep = nullptr);
@@ -0,0 +1,240 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Broadcast.h"
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "shared-memory ring needs lock-free 64-bit atomics");
+
+static void makeShmName(char *dst, size_t size, const char *name) {
+  if (name[0] == '/')
+    snprintf(dst, size, "%s", name);
+  else
+    snprintf(dst, size, "/%s", name);
+}
+
+/**************************************************************/
+/************************ Broadcaster *************************/
+/**************************************************************/
+
+Broadcaster::Broadcaster() {
+  name[0] = '\0';
+  ring = NULL;
+  prev = NULL;
+  frameNo = 0;
+}
+
+Broadcaster::~Broadcaster() { close(); }
+
+bool Broadcaster::open(const char *shmName, int wallDepth) {
+  makeShmName(name, sizeof(name), shmName);
+  // never reuse an existing segment: a spectator may still map it. A stale
+  // name is unlinked, which leaves the old mapping to its readers.
+  int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+  if ((fd < 0) && (errno == EEXIST) && (shm_unlink(name) == 0))
+    fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0) {
+    cerr << "shm_open error: " << strerror(errno) << endl;
+    return false;
+  }
+  if (ftruncate(fd, sizeof(BroadcastRing)) < 0) {
+    cerr << "ftruncate error: " << strerror(errno) << endl;
+    ::close(fd);
+    shm_unlink(name);
+    return false;
+  }
+  void *addr = mmap(NULL, sizeof(BroadcastRing), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (addr == MAP_FAILED) {
+    cerr << "mmap error: " << strerror(errno) << endl;
+    shm_unlink(name);
+    return false;
+  }
+
+  memset(addr, 0, sizeof(BroadcastRing));
+  ring = (BroadcastRing *) addr;
+  ring->wallDepth = wallDepth;
+  ring->version = BCAST_VERSION;
+  // readers check magic first, so it is published once the header is ready
+  ring->magic.store(BCAST_MAGIC, memory_order_release);
+  frameNo = 0;
+  return true;
+}
+
+void Broadcaster::publish(const Matrix *screen) {
+  if (ring == NULL) return;
+  int dy = screen->get_dy();
+  int dx = screen->get_dx();
+  if (dy * dx > BCAST_MAX_CELLS) {
+    cerr << "screen too large to broadcast" << endl;
+    return;
+  }
+  int **array = screen->get_array();
+
+  bool keyframe = (prev == NULL) || (frameNo % BCAST_KEYFRAME_INTERVAL == 0) ||
+                  (prev->get_dy() != dy) || (prev->get_dx() != dx);
+
+  BroadcastFrame &slot = ring->slots[frameNo % BCAST_SLOTS];
+  slot.seq.store(2 * frameNo + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+
+  int n = 0;
+  if (!keyframe) {
+    int **p_array = prev->get_array();
+    for (int y = 0; y < dy; y++)
+      for (int x = 0; x < dx; x++)
+        if (array[y][x] != p_array[y][x]) {
+          slot.cells[n].idx = y * dx + x;
+          slot.cells[n].val = array[y][x];
+          n++;
+        }
+  }
+  else {
+    for (int y = 0; y < dy; y++)
+      for (int x = 0; x < dx; x++) {
+        slot.cells[n].idx = y * dx + x;
+        slot.cells[n].val = array[y][x];
+        n++;
+      }
+  }
+  slot.frameNo = frameNo;
+  slot.dy = dy;
+  slot.dx = dx;
+  slot.keyframe = keyframe;
+  slot.nCells = n;
+  slot.seq.store(2 * frameNo + 2, memory_order_release);
+
+  if (keyframe)
+    ring->lastKeyframe.store(frameNo, memory_order_release);
+  ring->head.store(frameNo + 1, memory_order_release);
+  frameNo++;
+
+  if (prev == NULL)
+    prev = new Matrix(screen);
+  else
+    *prev = *screen;
+}
+
+void Broadcaster::close() {
+  if (ring != NULL) {
+    ring->closed.store(1, memory_order_release);
+    munmap(ring, sizeof(BroadcastRing));
+    shm_unlink(name);
+    ring = NULL;
+  }
+  delete prev;
+  prev = NULL;
+}
+
+/**************************************************************/
+/************************* Spectator **************************/
+/**************************************************************/
+
+Spectator::Spectator() {
+  ring = NULL;
+  screen = NULL;
+  frame = new BroadcastFrame;
+  next = 0;
+  synced = false;
+}
+
+Spectator::~Spectator() {
+  detach();
+  delete frame;
+}
+
+bool Spectator::attach(const char *shmName) {
+  char name[256];
+  makeShmName(name, sizeof(name), shmName);
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0) {
+    cerr << "shm_open error: " << strerror(errno) << endl;
+    return false;
+  }
+  void *addr = mmap(NULL, sizeof(BroadcastRing), PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (addr == MAP_FAILED) {
+    cerr << "mmap error: " << strerror(errno) << endl;
+    return false;
+  }
+  ring = (BroadcastRing *) addr;
+  if ((ring->magic.load(memory_order_acquire) != BCAST_MAGIC) || (ring->version != BCAST_VERSION)) {
+    cerr << "not a tetris broadcast: " << name << endl;
+    detach();
+    return false;
+  }
+  synced = false;
+  return true;
+}
+
+// Seqlock read of frame n; fails if the slot does not hold n or is overwritten meanwhile.
+bool Spectator::readFrame(uint64_t n, BroadcastFrame *dst) {
+  BroadcastFrame &slot = ring->slots[n % BCAST_SLOTS];
+  uint64_t want = 2 * n + 2;
+  if (slot.seq.load(memory_order_acquire) != want) return false;
+  dst->frameNo = slot.frameNo;
+  dst->dy = slot.dy;
+  dst->dx = slot.dx;
+  dst->keyframe = slot.keyframe;
+  dst->nCells = slot.nCells;
+  if (dst->nCells > BCAST_MAX_CELLS) return false;
+  memcpy(dst->cells, slot.cells, dst->nCells * sizeof(BroadcastCell));
+  atomic_thread_fence(memory_order_acquire);
+  return slot.seq.load(memory_order_relaxed) == want;
+}
+
+int Spectator::poll() {
+  if (ring == NULL) return 0;
+
+  uint64_t head = ring->head.load(memory_order_acquire);
+  if (head == 0) return 0;
+  if (!synced || (head - next > BCAST_SLOTS))
+    next = ring->lastKeyframe.load(memory_order_acquire);
+
+  int applied = 0;
+  while (next < head) {
+    if (!readFrame(next, frame)) {
+      // lapped by the producer; start over from the newest keyframe next time
+      synced = false;
+      break;
+    }
+    if (frame->keyframe) {
+      if ((screen == NULL) || (screen->get_dy() != frame->dy) || (screen->get_dx() != frame->dx)) {
+        delete screen;
+        screen = new Matrix(frame->dy, frame->dx);
+      }
+      synced = true;
+    }
+    if (synced) {
+      int **array = screen->get_array();
+      int dx = screen->get_dx();
+      for (int i = 0; i < frame->nCells; i++)
+        array[frame->cells[i].idx / dx][frame->cells[i].idx % dx] = frame->cells[i].val;
+      applied++;
+    }
+    next++;
+  }
+  return applied;
+}
+
+bool Spectator::isClosed() const {
+  return (ring == NULL) || (ring->closed.load(memory_order_acquire) != 0);
+}
+
+int Spectator::get_wallDepth() const { return (ring != NULL) ? ring->wallDepth : 0; }
+
+Matrix *Spectator::get_screen() const { return screen; }
+
+void Spectator::detach() {
+  if (ring != NULL) {
+    munmap(ring, sizeof(BroadcastRing));
+    ring = NULL;
+  }
+  delete screen;
+  screen = NULL;
+  synced = false;
+}
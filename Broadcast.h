@@ -0,0 +1,74 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include "Matrix.h"
+
+// Spectator broadcast over POSIX shared memory.
+// The game publishes one frame per drawScreen: either a keyframe holding
+// every cell of oScreen, or a delta holding only the cells that changed.
+// Frames go into a single-producer, multi-consumer ring; readers never
+// block the producer and resync from the latest keyframe when lapped.
+
+#define BCAST_MAGIC 0x54524253  // "TRBS"
+#define BCAST_VERSION 1
+#define BCAST_SLOTS 256
+#define BCAST_MAX_CELLS 1024
+#define BCAST_KEYFRAME_INTERVAL 32
+
+struct BroadcastCell {
+  uint16_t idx;   // y * dx + x
+  int16_t val;
+};
+
+struct BroadcastFrame {
+  std::atomic<uint64_t> seq;  // odd while being written, 2*(frameNo+1) when done
+  uint64_t frameNo;
+  uint16_t dy;
+  uint16_t dx;
+  uint16_t keyframe;
+  uint16_t nCells;
+  BroadcastCell cells[BCAST_MAX_CELLS];
+};
+
+struct BroadcastRing {
+  std::atomic<uint32_t> magic;        // stored last, with release order
+  uint32_t version;
+  uint32_t wallDepth;
+  std::atomic<uint32_t> closed;
+  std::atomic<uint64_t> head;          // number of frames published so far
+  std::atomic<uint64_t> lastKeyframe;  // frameNo of the latest keyframe
+  BroadcastFrame slots[BCAST_SLOTS];
+};
+
+class Broadcaster {
+private:
+  char name[256];
+  BroadcastRing *ring;
+  Matrix *prev;
+  uint64_t frameNo;
+public:
+  Broadcaster();
+  ~Broadcaster();
+  bool open(const char *shmName, int wallDepth);
+  void publish(const Matrix *screen);
+  void close();
+};
+
+class Spectator {
+private:
+  BroadcastRing *ring;
+  Matrix *screen;
+  BroadcastFrame *frame;   // scratch copy of the frame being read
+  uint64_t next;
+  bool synced;
+  bool readFrame(uint64_t n, BroadcastFrame *dst);
+public:
+  Spectator();
+  ~Spectator();
+  bool attach(const char *shmName);
+  int poll();            // applies pending frames, returns how many were applied
+  bool isClosed() const;
+  int get_wallDepth() const;
+  Matrix *get_screen() const;
+  void detach();
+};
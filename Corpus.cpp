@@ -0,0 +1,236 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Corpus.h"
+
+#define PLAY_COLUMNS (((1u << SCREEN_DX) - 1) << SCREEN_DW)
+#define FULL_ROW ((1u << ARRAY_DX) - 1)
+
+bool corpusCell(const CorpusPosition &pos, int y, int c) {
+  int i = y * SCREEN_DX + c;
+  return (pos.field[i >> 6] >> (i & 63)) & 1;
+}
+
+/**************************************************************/
+/*********************** CorpusWriter *************************/
+/**************************************************************/
+
+CorpusWriter::CorpusWriter() {
+  fp = NULL;
+  memset(&header, 0, sizeof(header));
+}
+
+CorpusWriter::~CorpusWriter() { close(); }
+
+bool CorpusWriter::open(const char *path) {
+  close();
+  fp = fopen(path, "wb");
+  if (fp == NULL) {
+    cerr << "cannot open " << path << ": " << strerror(errno) << endl;
+    return false;
+  }
+  memset(&header, 0, sizeof(header));
+  header.magic = CORPUS_MAGIC;
+  header.version = CORPUS_VERSION;
+  header.headerSize = sizeof(CorpusHeader);
+  header.recordSize = sizeof(CorpusPosition);
+  header.fieldDy = SCREEN_DY;
+  header.fieldDx = SCREEN_DX;
+  // the count stays 0 until close(), so a cut-off file reads as empty
+  if (fwrite(&header, sizeof(header), 1, fp) != 1) {
+    cerr << "cannot write " << path << endl;
+    close();
+    return false;
+  }
+  return true;
+}
+
+bool CorpusWriter::append(const Matrix *iScreen, int blockType, int blockDegree, int top, int left) {
+  if (fp == NULL) return false;
+  CorpusPosition pos;
+  memset(&pos, 0, sizeof(pos));
+  int **array = iScreen->get_array();
+  for (int y = 0; y < SCREEN_DY; y++)
+    for (int c = 0; c < SCREEN_DX; c++) {
+      int i = y * SCREEN_DX + c;
+      if (array[y][SCREEN_DW + c] != 0)
+        pos.field[i >> 6] |= (uint64_t) 1 << (i & 63);
+    }
+  pos.blockType = blockType;
+  pos.blockDegree = blockDegree;
+  pos.top = top;
+  pos.left = left;
+  if (fwrite(&pos, sizeof(pos), 1, fp) != 1) {
+    cerr << "cannot write corpus: " << strerror(errno) << endl;
+    return false;
+  }
+  header.nPositions++;
+  return true;
+}
+
+bool CorpusWriter::close() {
+  if (fp == NULL) return true;
+  bool ok = (fseek(fp, 0, SEEK_SET) == 0) && (fwrite(&header, sizeof(header), 1, fp) == 1);
+  ok = (fclose(fp) == 0) && ok;
+  fp = NULL;
+  if (!ok)
+    cerr << "cannot write corpus header" << endl;
+  return ok;
+}
+
+uint64_t CorpusWriter::get_nPositions() const { return header.nPositions; }
+
+/**************************************************************/
+/************************ CorpusFile **************************/
+/**************************************************************/
+
+CorpusFile::CorpusFile() {
+  addr = NULL;
+  length = 0;
+  header = NULL;
+  positions = NULL;
+}
+
+CorpusFile::~CorpusFile() { close(); }
+
+bool CorpusFile::open(const char *path) {
+  close();
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0) {
+    cerr << "cannot open " << path << ": " << strerror(errno) << endl;
+    return false;
+  }
+  struct stat st;
+  if ((fstat(fd, &st) < 0) || ((size_t) st.st_size < sizeof(CorpusHeader))) {
+    cerr << "invalid corpus " << path << endl;
+    ::close(fd);
+    return false;
+  }
+  length = st.st_size;
+  addr = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (addr == MAP_FAILED) {
+    cerr << "mmap error: " << strerror(errno) << endl;
+    addr = NULL;
+    return false;
+  }
+
+  header = (const CorpusHeader *) addr;
+  if ((header->magic != CORPUS_MAGIC) || (header->version != CORPUS_VERSION) ||
+      (header->headerSize != sizeof(CorpusHeader)) || (header->recordSize != sizeof(CorpusPosition)) ||
+      (header->fieldDy != SCREEN_DY) || (header->fieldDx != SCREEN_DX) ||
+      ((length - sizeof(CorpusHeader)) / sizeof(CorpusPosition) < header->nPositions)) {
+    cerr << "invalid corpus " << path << endl;
+    close();
+    return false;
+  }
+  positions = (const CorpusPosition *) ((const char *) addr + header->headerSize);
+  return true;
+}
+
+void CorpusFile::close() {
+  if (addr != NULL)
+    munmap(addr, length);
+  addr = NULL;
+  length = 0;
+  header = NULL;
+  positions = NULL;
+}
+
+uint64_t CorpusFile::get_nPositions() const { return (header != NULL) ? header->nPositions : 0; }
+
+const CorpusPosition *CorpusFile::get_position(uint64_t i) const { return positions + i; }
+
+void CorpusFile::prefetch(uint64_t from, uint64_t to) const {
+  if ((positions == NULL) || (to <= from)) return;
+  long page = sysconf(_SC_PAGESIZE);
+  uintptr_t begin = (uintptr_t) (positions + from) & ~(uintptr_t) (page - 1);
+  uintptr_t end = (uintptr_t) (positions + to);
+  madvise((void *) begin, end - begin, MADV_WILLNEED);
+}
+
+/**************************************************************/
+/********************** PlacementQuery ************************/
+/**************************************************************/
+
+PlacementQuery::PlacementQuery(Matrix *setOfBlockObjects[MAX_BLK_TYPES][MAX_BLK_DEGREES]) {
+  for (int t = 0; t < MAX_BLK_TYPES; t++)
+    for (int d = 0; d < MAX_BLK_DEGREES; d++) {
+      Matrix *blk = setOfBlockObjects[t][d];
+      int **array = blk->get_array();
+      Mask &m = masks[t][d];
+      m.dy = min(blk->get_dy(), SCREEN_DW + 1);
+      for (int y = 0; y < SCREEN_DW + 1; y++) {
+        m.rows[y] = 0;
+        for (int x = 0; (y < m.dy) && (x < blk->get_dx()); x++)
+          if (array[y][x] != 0)
+            m.rows[y] |= 1u << x;
+      }
+    }
+}
+
+// one row mask per board row, bit x = column x of arrayScreen
+void PlacementQuery::unpack(const CorpusPosition &pos, uint32_t board[ARRAY_DY]) const {
+  uint32_t walls = FULL_ROW & ~PLAY_COLUMNS;
+  // rows are SCREEN_DX consecutive bits and may straddle the two words
+  unsigned __int128 field = ((unsigned __int128) pos.field[1] << 64) | pos.field[0];
+  for (int y = 0; y < SCREEN_DY; y++) {
+    uint32_t row = (uint32_t) (field >> (y * SCREEN_DX)) & ((1u << SCREEN_DX) - 1);
+    board[y] = walls | (row << SCREEN_DW);
+  }
+  for (int y = SCREEN_DY; y < ARRAY_DY; y++)
+    board[y] = FULL_ROW;
+}
+
+bool PlacementQuery::fits(const uint32_t *board, const Mask &m, int top, int left) const {
+  if ((top < 0) || (left < 0) || (top + m.dy > ARRAY_DY)) return false;
+  for (int r = 0; r < m.dy; r++) {
+    uint32_t cells = m.rows[r] << left;
+    if ((board[top + r] & cells) || (cells & ~FULL_ROW))
+      return false;
+  }
+  return true;
+}
+
+int PlacementQuery::placements(const CorpusPosition &pos, Placement out[MAX_PLACEMENTS]) const {
+  uint32_t board[ARRAY_DY];
+  unpack(pos, board);
+  int type = pos.blockType % MAX_BLK_TYPES;
+  int n = 0;
+
+  for (int d = 0; d < MAX_BLK_DEGREES; d++) {
+    const Mask &m = masks[type][d];
+    for (int left = 0; left + 1 < ARRAY_DX; left++) {
+      if (!fits(board, m, pos.top, left)) continue;
+      int landing = pos.top;
+      while (fits(board, m, landing + 1, left))
+        landing++;
+
+      uint32_t after[ARRAY_DY];
+      memcpy(after, board, sizeof(after));
+      for (int r = 0; r < m.dy; r++)
+        after[landing + r] |= m.rows[r] << left;
+
+      // deleteFullLines: rows landing .. landing + dy - 1 above the floor, in order
+      int lines = 0;
+      for (int i = landing; (i < landing + m.dy) && (i < SCREEN_DY); i++) {
+        if (after[i] != FULL_ROW) continue;
+        for (int y = i; y > 0; y--)
+          after[y] = after[y - 1];
+        lines++;
+      }
+
+      Placement &p = out[n++];
+      p.degree = d;
+      p.left = left;
+      p.landing = landing;
+      p.lines = lines;
+      p.gameOver = (after[0] & PLAY_COLUMNS) != 0;
+    }
+  }
+  return n;
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include "Matrix.h"
+#include "Tetris.h"
+
+// Position corpus, version 1 (native little-endian):
+//   CorpusHeader (32 bytes)
+//   nPositions CorpusPosition records (24 bytes each)
+// A position is the playfield of a board (SCREEN_DY x SCREEN_DX, walls and
+// floor left out) packed one bit per cell, row-major from the top left,
+// plus the current block. Cells only say filled or empty: a 2+ cell of the
+// game is stored as filled. The file is read through mmap in place, so
+// queries never build a Matrix per position.
+
+#define CORPUS_MAGIC 0x534f5054  // "TPOS"
+#define CORPUS_VERSION 1
+
+struct CorpusHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t headerSize;
+  uint16_t recordSize;
+  uint8_t fieldDy;
+  uint8_t fieldDx;
+  uint32_t reserved0;
+  uint64_t nPositions;
+  uint64_t reserved1;
+};
+
+struct CorpusPosition {
+  uint64_t field[2];
+  uint8_t blockType;
+  uint8_t blockDegree;
+  int8_t top;
+  int8_t left;
+  uint32_t reserved;
+};
+
+static_assert(sizeof(CorpusHeader) == 32, "corpus header must stay 32 bytes");
+static_assert(sizeof(CorpusPosition) == 24, "corpus records must stay 24 bytes");
+static_assert(SCREEN_DY * SCREEN_DX <= 128, "the field must fit in two words");
+
+// Appends positions; the header's count is written by close().
+class CorpusWriter {
+private:
+  FILE *fp;
+  CorpusHeader header;
+public:
+  CorpusWriter();
+  ~CorpusWriter();
+  bool open(const char *path);
+  bool append(const Matrix *iScreen, int blockType, int blockDegree, int top, int left);
+  bool close();
+  uint64_t get_nPositions() const;
+};
+
+class CorpusFile {
+private:
+  void *addr;
+  size_t length;
+  const CorpusHeader *header;
+  const CorpusPosition *positions;
+public:
+  CorpusFile();
+  ~CorpusFile();
+  bool open(const char *path);
+  void close();
+  uint64_t get_nPositions() const;
+  const CorpusPosition *get_position(uint64_t i) const;
+  // advise the kernel that [from, to) is read next, in order
+  void prefetch(uint64_t from, uint64_t to) const;
+};
+
+bool corpusCell(const CorpusPosition &pos, int y, int c);
+
+// Where the current block of a position can go: every orientation and
+// column where it fits at the block's row, dropped straight down.
+struct Placement {
+  int8_t degree;
+  int8_t left;
+  int8_t landing;     // top of the block once it rests
+  uint8_t lines;      // lines deleteFullLines() would count
+  uint8_t gameOver;   // checkIsTouchedTop() after the lines are gone
+};
+
+#define MAX_PLACEMENTS (MAX_BLK_DEGREES * ARRAY_DX)
+
+// Answers placement queries with row bit masks (walls and floor included,
+// as in arrayScreen), from the block objects the game uses.
+class PlacementQuery {
+private:
+  struct Mask {
+    int dy;
+    uint32_t rows[SCREEN_DW + 1];
+  };
+  Mask masks[MAX_BLK_TYPES][MAX_BLK_DEGREES];
+  bool fits(const uint32_t *board, const Mask &m, int top, int left) const;
+public:
+  PlacementQuery(Matrix *setOfBlockObjects[MAX_BLK_TYPES][MAX_BLK_DEGREES]);
+  void unpack(const CorpusPosition &pos, uint32_t board[ARRAY_DY]) const;
+  int placements(const CorpusPosition &pos, Placement out[MAX_PLACEMENTS]) const;
+};
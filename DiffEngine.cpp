@@ -0,0 +1,514 @@
+#include <iostream>
+#include <iomanip>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "Matrix.h"
+#include "Tetris.h"
+#include "BatchEngine.h"
+#include "BoardFeatures.h"
+#include "Bot.h"
+#include "Scheduler.h"
+
+using namespace std;
+
+// Differential test of board engines against the reference game.
+// Every case is a seed plus a key stream. The reference (Tetris: probeBlock,
+// deleteFullLines, checkIsTouchedTop and the rollback switch, as in main())
+// and the engine under test play the same stream side by side, and the full
+// state is compared after every key. Key streams mix bot placements (so
+// lines get cleared and boards get deep) with random keys, wrong keys
+// included. A divergence is shrunk to a minimal key stream by delta
+// debugging and printed with both states.
+//
+// Engines: batch (BatchEngine, all games in lanes) and features (the
+// reference game with BoardFeatures following each lock incrementally,
+// checked against features scanned from the reference board's cells).
+
+#define N_BOARD_FEATURES 8
+
+const char *boardFeatureNames[N_BOARD_FEATURES] = {
+    "height", "maxHeight", "holes", "bumpiness", "rowTransitions", "colTransitions", "wellSum", "maxWell"
+};
+
+// What is compared after each key. Cells are clamped to 2 (2 or more).
+struct EngineState {
+    int top;
+    int left;
+    int blockType;
+    int blockDegree;
+    int score;
+    int nBlocks;
+    bool newBlockNeeded;
+    bool gameOver;
+    unsigned int rngSeed;
+    int iCells[ARRAY_DY][ARRAY_DX];
+    int oCells[ARRAY_DY][ARRAY_DX];
+    bool hasFeatures;
+    int features[N_BOARD_FEATURES];
+};
+
+Matrix *setOfBlockObjects[MAX_BLK_TYPES][MAX_BLK_DEGREES];
+SparsePiece pieces[MAX_BLK_TYPES][MAX_BLK_DEGREES];
+
+// The features of iScreen the slow and obvious way, cell by cell with the
+// real walls and floor, sharing nothing with BoardFeatures.
+void scanFeatures(const Matrix *iScreen, int features[N_BOARD_FEATURES]) {
+    int **array = iScreen->get_array();
+    int heights[SCREEN_DX];
+    int holes = 0, colTransitions = 0, rowTransitions = 0;
+    for (int c = 0; c < SCREEN_DX; c++) {
+        int x = SCREEN_DW + c;
+        heights[c] = 0;
+        for (int y = SCREEN_DY - 1; y >= 0; y--) {
+            if (array[y][x] != 0)
+                heights[c] = SCREEN_DY - y;
+            if ((array[y][x] != 0) != (array[y + 1][x] != 0))
+                colTransitions++;
+        }
+        for (int y = SCREEN_DY - heights[c]; y < SCREEN_DY; y++)
+            holes += (array[y][x] == 0);
+    }
+    for (int y = 0; y < SCREEN_DY; y++)
+        for (int x = SCREEN_DW; x <= SCREEN_DW + SCREEN_DX; x++)
+            if ((array[y][x - 1] != 0) != (array[y][x] != 0))
+                rowTransitions++;
+    int height = 0, maxHeight = 0, bumpiness = 0, wellSum = 0, maxWell = 0;
+    for (int c = 0; c < SCREEN_DX; c++) {
+        height += heights[c];
+        maxHeight = max(maxHeight, heights[c]);
+        if (c > 0)
+            bumpiness += abs(heights[c] - heights[c - 1]);
+        int leftHeight = (c > 0) ? heights[c - 1] : SCREEN_DY;
+        int rightHeight = (c < SCREEN_DX - 1) ? heights[c + 1] : SCREEN_DY;
+        int well = max(0, min(leftHeight, rightHeight) - heights[c]);
+        wellSum += well;
+        maxWell = max(maxWell, well);
+    }
+    int values[N_BOARD_FEATURES] = {
+        height, maxHeight, holes, bumpiness, rowTransitions, colTransitions, wellSum, maxWell
+    };
+    memcpy(features, values, sizeof(values));
+}
+
+void readFeatures(const BoardFeatures &f, int features[N_BOARD_FEATURES]) {
+    int values[N_BOARD_FEATURES] = {
+        f.get_height(), f.get_maxHeight(), f.get_holes(), f.get_bumpiness(),
+        f.get_rowTransitions(), f.get_colTransitions(), f.get_wellSum(), f.get_maxWell()
+    };
+    memcpy(features, values, sizeof(values));
+}
+
+// An engine playing nGames games at once, one key per game and step.
+class EngineUnderTest {
+public:
+    virtual ~EngineUnderTest() {}
+    virtual void step(const char *keys) = 0;
+    virtual void read(int g, EngineState *state) const = 0;
+    // when true, the reference scans its boards' features to compare with
+    virtual bool hasFeatures() const { return false; }
+};
+
+class ReferenceEngine : public EngineUnderTest {
+private:
+    vector<Tetris *> games;
+    bool scan;
+public:
+    ReferenceEngine(Matrix *setOfBlockObjects[MAX_BLK_TYPES][MAX_BLK_DEGREES], int nGames, const unsigned int *seeds,
+                    bool scan = false) : scan(scan) {
+        for (int g = 0; g < nGames; g++)
+            games.push_back(new Tetris(setOfBlockObjects, seeds[g], false));
+    }
+    ~ReferenceEngine() {
+        for (size_t g = 0; g < games.size(); g++)
+            delete games[g];
+    }
+    const Tetris &game(int g) const { return *games[g]; }
+    void step(const char *keys) {
+        for (size_t g = 0; g < games.size(); g++)
+            games[g]->step(keys[g]);
+    }
+    void read(int g, EngineState *state) const {
+        const Tetris *t = games[g];
+        state->top = t->get_top();
+        state->left = t->get_left();
+        state->blockType = t->get_blockType();
+        state->blockDegree = t->get_idxBlockDegree();
+        state->score = t->get_score();
+        state->nBlocks = t->get_nBlocks();
+        state->newBlockNeeded = t->isNewBlockNeeded();
+        state->gameOver = t->isGameOver();
+        state->rngSeed = t->get_rngSeed();
+        int **i_array = t->get_iScreen()->get_array();
+        int **o_array = t->get_oScreen()->get_array();
+        for (int y = 0; y < ARRAY_DY; y++)
+            for (int x = 0; x < ARRAY_DX; x++) {
+                state->iCells[y][x] = min(i_array[y][x], 2);
+                state->oCells[y][x] = min(o_array[y][x], 2);
+            }
+        state->hasFeatures = scan;
+        if (scan)
+            scanFeatures(t->get_iScreen(), state->features);
+    }
+};
+
+class BatchEngineUnderTest : public EngineUnderTest {
+private:
+    BatchEngine engine;
+public:
+    BatchEngineUnderTest(int nGames, const unsigned int *seeds) : engine(nGames, seeds) {}
+    void step(const char *keys) { engine.step(keys); }
+    void read(int g, EngineState *state) const {
+        state->top = engine.get_top(g);
+        state->left = engine.get_left(g);
+        state->blockType = engine.get_blockType(g);
+        state->blockDegree = engine.get_idxBlockDegree(g);
+        state->score = engine.get_score(g);
+        state->nBlocks = engine.get_nBlocks(g);
+        state->newBlockNeeded = engine.isNewBlockNeeded(g);
+        state->gameOver = engine.isGameOver(g);
+        state->rngSeed = engine.get_rngSeed(g);
+        for (int y = 0; y < ARRAY_DY; y++)
+            for (int x = 0; x < ARRAY_DX; x++) {
+                state->iCells[y][x] = engine.cell(g, y, x);
+                state->oCells[y][x] = engine.composedCell(g, y, x);
+            }
+        state->hasFeatures = false;
+    }
+};
+
+// Plays the reference rules and hands every locked block to BoardFeatures,
+// the way the bot's evaluation does, without ever rescanning the board.
+class FeaturesUnderTest : public EngineUnderTest {
+private:
+    ReferenceEngine games;
+    vector<BoardFeatures> features;
+    vector<int> locked;     // scratch: the block each game locks in this step, or -1
+    vector<int> lockedTop;
+    vector<int> lockedLeft;
+public:
+    FeaturesUnderTest(int nGames, const unsigned int *seeds)
+        : games(setOfBlockObjects, nGames, seeds), features(nGames), locked(nGames), lockedTop(nGames),
+          lockedLeft(nGames) {}
+    bool hasFeatures() const { return true; }
+    void step(const char *keys) {
+        for (size_t g = 0; g < features.size(); g++) {
+            const Tetris &t = games.game(g);
+            // step() starts with lockBlock(), which merges the waiting block
+            bool locks = t.isNewBlockNeeded() && !t.isGameOver();
+            locked[g] = locks ? t.get_blockType() * MAX_BLK_DEGREES + t.get_idxBlockDegree() : -1;
+            lockedTop[g] = t.get_top();
+            lockedLeft[g] = t.get_left();
+        }
+        games.step(keys);
+        for (size_t g = 0; g < features.size(); g++)
+            if (locked[g] >= 0)
+                features[g].lock(pieces[locked[g] / MAX_BLK_DEGREES][locked[g] % MAX_BLK_DEGREES],
+                                 lockedTop[g], lockedLeft[g]);
+    }
+    void read(int g, EngineState *state) const {
+        games.read(g, state);
+        state->hasFeatures = true;
+        readFeatures(features[g], state->features);
+    }
+};
+
+const char *engineNames[] = { "batch", "features" };
+#define N_ENGINES ((int) (sizeof(engineNames) / sizeof(engineNames[0])))
+
+EngineUnderTest *createEngine(int id, int nGames, const unsigned int *seeds) {
+    switch (id) {
+        case 0: return new BatchEngineUnderTest(nGames, seeds);
+        case 1: return new FeaturesUnderTest(nGames, seeds);
+    }
+    return NULL;
+}
+
+// Name of the first field that differs, NULL if none. Once the game is over
+// only the outcome counts: the position of the last block is not defined.
+const char *compareStates(const EngineState &a, const EngineState &b) {
+    if (a.gameOver != b.gameOver) return "gameOver";
+    if (a.score != b.score) return "score";
+    if (a.nBlocks != b.nBlocks) return "nBlocks";
+    if (a.rngSeed != b.rngSeed) return "rngSeed";
+    if (a.blockType != b.blockType) return "blockType";
+    if (memcmp(a.iCells, b.iCells, sizeof(a.iCells)) != 0) return "iScreen";
+    for (int i = 0; a.hasFeatures && b.hasFeatures && (i < N_BOARD_FEATURES); i++)
+        if (a.features[i] != b.features[i]) return boardFeatureNames[i];
+    if (a.gameOver) return NULL;
+    if (a.top != b.top) return "top";
+    if (a.left != b.left) return "left";
+    if (a.blockDegree != b.blockDegree) return "blockDegree";
+    if (a.newBlockNeeded != b.newBlockNeeded) return "newBlockNeeded";
+    if (memcmp(a.oCells, b.oCells, sizeof(a.oCells)) != 0) return "oScreen";
+    return NULL;
+}
+
+/**************************************************************/
+/************************ Key streams *************************/
+/**************************************************************/
+
+#define RANDOM_KEYS "asdwpl x"
+
+// Feeds one game: bot placements, now and then spoiled by a random key, and
+// runs of random keys in between.
+class KeySource {
+private:
+    unsigned int rng;
+    char queue[64];
+    int nQueued;
+    int next;
+public:
+    KeySource(unsigned int seed) : rng(seed), nQueued(0), next(0) {}
+    char nextKey(const Bot &bot, Matrix *setOfBlockObjects[MAX_BLK_TYPES][MAX_BLK_DEGREES],
+                 SparsePiece pieces[MAX_BLK_TYPES][MAX_BLK_DEGREES], const Tetris &game) {
+        if (next == nQueued) {
+            next = 0;
+            if (rand_r(&rng) % 3 != 0) {
+                BotMove move = bot.choose(setOfBlockObjects, pieces, game);
+                nQueued = bot.plan(game, move, queue, sizeof(queue));
+                if (rand_r(&rng) % 4 == 0)
+                    queue[rand_r(&rng) % nQueued] = RANDOM_KEYS[rand_r(&rng) % strlen(RANDOM_KEYS)];
+            } else {
+                nQueued = 1 + rand_r(&rng) % 8;
+                for (int i = 0; i < nQueued; i++)
+                    queue[i] = RANDOM_KEYS[rand_r(&rng) % strlen(RANDOM_KEYS)];
+            }
+        }
+        return queue[next++];
+    }
+};
+
+/**************************************************************/
+/************************* Harness ****************************/
+/**************************************************************/
+
+struct Divergence {
+    unsigned int seed;
+    string keys;       // up to and including the key after which the states differ
+    const char *field;
+};
+
+// Replays one recorded stream on a single lane; returns the divergence step or -1.
+int replay(int engineId, unsigned int seed, const string &keys, EngineState *ref, EngineState *alt, const char **field) {
+    EngineUnderTest *engine = createEngine(engineId, 1, &seed);
+    ReferenceEngine reference(setOfBlockObjects, 1, &seed, engine->hasFeatures());
+    int step = -1;
+    for (size_t i = 0; i < keys.size(); i++) {
+        reference.step(&keys[i]);
+        engine->step(&keys[i]);
+        reference.read(0, ref);
+        engine->read(0, alt);
+        if ((*field = compareStates(*ref, *alt)) != NULL) {
+            step = i;
+            break;
+        }
+    }
+    delete engine;
+    return step;
+}
+
+bool diverges(int engineId, unsigned int seed, const string &keys) {
+    EngineState ref, alt;
+    const char *field;
+    return replay(engineId, seed, keys, &ref, &alt, &field) >= 0;
+}
+
+// ddmin over the keys: drop chunks while the streams still diverge, halving
+// the chunk size whenever no chunk can go; then cut after the divergence.
+string shrink(int engineId, unsigned int seed, string keys) {
+    int n = 2;
+    while (keys.size() >= 2) {
+        int chunk = (keys.size() + n - 1) / n;
+        bool reduced = false;
+        for (int start = 0; start < (int) keys.size(); start += chunk) {
+            string candidate = keys.substr(0, start) + keys.substr(min((int) keys.size(), start + chunk));
+            if (!candidate.empty() && diverges(engineId, seed, candidate)) {
+                keys = candidate;
+                n = max(n - 1, 2);
+                reduced = true;
+                break;
+            }
+        }
+        if (reduced) continue;
+        if (n >= (int) keys.size()) break;
+        n = min(n * 2, (int) keys.size());
+    }
+    EngineState ref, alt;
+    const char *field;
+    int step = replay(engineId, seed, keys, &ref, &alt, &field);
+    return keys.substr(0, step + 1);
+}
+
+void printBoard(const char *name, const int cells[ARRAY_DY][ARRAY_DX]) {
+    cout << name << ":" << endl;
+    for (int y = 0; y < ARRAY_DY; y++) {
+        for (int x = 0; x < ARRAY_DX; x++)
+            cout << cells[y][x];
+        cout << endl;
+    }
+}
+
+void printState(const char *name, const EngineState &s) {
+    cout << name << ": top " << s.top << " left " << s.left << " type " << s.blockType
+         << " degree " << s.blockDegree << " score " << s.score << " nBlocks " << s.nBlocks
+         << " newBlockNeeded " << s.newBlockNeeded << " gameOver " << s.gameOver << " rngSeed " << s.rngSeed << endl;
+    if (s.hasFeatures) {
+        cout << name << " features:";
+        for (int i = 0; i < N_BOARD_FEATURES; i++)
+            cout << " " << boardFeatureNames[i] << " " << s.features[i];
+        cout << endl;
+    }
+}
+
+void report(int engineId, const Divergence &d) {
+    string keys = shrink(engineId, d.seed, d.keys);
+    EngineState ref, alt;
+    const char *field;
+    replay(engineId, d.seed, keys, &ref, &alt, &field);
+    cout << "DIVERGENCE in " << field << ": seed " << d.seed << ", " << d.keys.size() << " keys shrunk to "
+         << keys.size() << endl;
+    cout << "keys: \"";
+    for (size_t i = 0; i < keys.size(); i++)
+        cout << keys[i];
+    cout << "\"" << endl;
+    printState("reference", ref);
+    printState(engineNames[engineId], alt);
+    printBoard("reference oScreen", ref.oCells);
+    printBoard("engine oScreen", alt.oCells);
+}
+
+unsigned int caseSeed(unsigned long long baseSeed, long c) {
+    unsigned long long h = baseSeed * 0x9E3779B97F4A7C15ULL + c;
+    h ^= h >> 31;
+    h *= 0x94D049BB133111EBULL;
+    h ^= h >> 29;
+    return (unsigned int) h;
+}
+
+void usage(const char *name) {
+    cerr << "usage: " << name << " [-e engine] [-j threads] [-n batches] [-g games_per_batch]"
+         << " [-l keys_per_game] [-s seed]" << endl;
+    cerr << "engines:";
+    for (int i = 0; i < N_ENGINES; i++)
+        cerr << " " << engineNames[i];
+    cerr << endl;
+}
+
+int main(int argc, char *argv[]) {
+    int engineId = 0;
+    int nThreads = 0;
+    long nBatches = 64;
+    int nGames = 64;
+    int nKeys = 1000;
+    unsigned long long seed = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "e:j:n:g:l:s:")) != -1) {
+        switch (opt) {
+            case 'e':
+                engineId = -1;
+                for (int i = 0; i < N_ENGINES; i++)
+                    if (strcmp(optarg, engineNames[i]) == 0)
+                        engineId = i;
+                break;
+            case 'j': nThreads = atoi(optarg); break;
+            case 'n': nBatches = atol(optarg); break;
+            case 'g': nGames = atoi(optarg); break;
+            case 'l': nKeys = atoi(optarg); break;
+            case 's': seed = strtoull(optarg, NULL, 10); break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if ((engineId < 0) || (nBatches < 1) || (nGames < 1) || (nKeys < 1)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    createBlockObjects(setOfBlockObjects);
+    createSparsePieces(setOfBlockObjects, pieces);
+    double weights[BOT_NFEATURES] = { 1.0, -0.5, -1.5, -0.3, -0.2 };
+    Bot bot(weights);
+    TaskScheduler scheduler(nThreads);
+
+    std::mutex lock;
+    vector<Divergence> divergences;
+    std::atomic<long> nSteps(0);
+    std::atomic<long> nLines(0);
+
+    auto begin = chrono::steady_clock::now();
+    // a batch is nGames cases in lockstep, so the batch engine runs wide
+    scheduler.parallelFor(0, nBatches, 1, [&](long from, long to, int worker) {
+        vector<unsigned int> seeds(nGames);
+        vector<char> keys(nGames);
+        EngineState ref, alt;
+        for (long b = from; b < to; b++) {
+            vector<KeySource> sources;
+            vector<string> streams(nGames);
+            vector<bool> done(nGames, false);
+            for (int g = 0; g < nGames; g++) {
+                seeds[g] = caseSeed(seed, b * nGames + g);
+                sources.push_back(KeySource(seeds[g] ^ 0x5bd1e995));
+            }
+            EngineUnderTest *engine = createEngine(engineId, nGames, &seeds[0]);
+            ReferenceEngine reference(setOfBlockObjects, nGames, &seeds[0], engine->hasFeatures());
+            long steps = 0;
+            int nDone = 0;
+            for (int i = 0; (i < nKeys) && (nDone < nGames); i++) {
+                for (int g = 0; g < nGames; g++) {
+                    keys[g] = done[g] ? 'w' : sources[g].nextKey(bot, setOfBlockObjects, pieces, reference.game(g));
+                    if (!done[g])
+                        streams[g] += keys[g];
+                }
+                reference.step(&keys[0]);
+                engine->step(&keys[0]);
+                for (int g = 0; g < nGames; g++) {
+                    if (done[g]) continue;
+                    steps++;
+                    reference.read(g, &ref);
+                    engine->read(g, &alt);
+                    const char *field = compareStates(ref, alt);
+                    if ((field != NULL) || ref.gameOver) {
+                        done[g] = true;
+                        nDone++;
+                    }
+                    if (field != NULL) {
+                        lock_guard<std::mutex> guard(lock);
+                        Divergence d = { seeds[g], streams[g], field };
+                        divergences.push_back(d);
+                    }
+                }
+            }
+            for (int g = 0; g < nGames; g++)
+                nLines += reference.game(g).get_score();
+            nSteps += steps;
+            delete engine;
+        }
+    });
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+    cout << "engine " << engineNames[engineId] << ": " << nBatches * nGames << " games, " << nSteps << " steps, "
+         << nLines << " lines, " << divergences.size() << " divergences" << endl;
+    cout << fixed << setprecision(0) << nSteps * 60 / seconds << " steps/min on " << scheduler.get_nThreads()
+         << " threads" << endl;
+
+    if (!divergences.empty()) {
+        // the smallest seed, so that a rerun reports the same case
+        size_t first = 0;
+        for (size_t i = 1; i < divergences.size(); i++)
+            if (divergences[i].seed < divergences[first].seed)
+                first = i;
+        report(engineId, divergences[first]);
+    }
+
+    deleteBlockObjects(setOfBlockObjects);
+    return divergences.empty() ? 0 : 1;
+}
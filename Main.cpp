@@ -12,6 +12,11 @@
 
 #include "colors.h"
 #include "Matrix.h"
+#include "Broadcast.h"
+#include "Renderer.h"
+#include "Perf.h"
+#include "Trace.h"
+#include "Tetris.h"
 
 using namespace std;
 
@@ -27,6 +32,7 @@ int tty_reset(int fd);    /* restore terminal's mode */
 
 /* Read 1 character - echo defines echo mode */
 char getch() {
+    TraceSpan span("input wait");
     char ch;
     int n;
     while (1) {
@@ -90,182 +96,84 @@ void registerAlarm() {
 }
 
 /**************************************************************/
-/**************** Tetris Blocks Definitions *******************/
+/******************** Tetris Screen Drawing *******************/
 /**************************************************************/
-#define MAX_BLK_TYPES 7
-#define MAX_BLK_DEGREES 4
-
-int T0D0[] = {1, 1, 1, 1, -1};
-int T0D1[] = {1, 1, 1, 1, -1};
-int T0D2[] = {1, 1, 1, 1, -1};
-int T0D3[] = {1, 1, 1, 1, -1};
-
-int T1D0[] = {0, 1, 0, 1, 1, 1, 0, 0, 0, -1};
-int T1D1[] = {0, 1, 0, 0, 1, 1, 0, 1, 0, -1};
-int T1D2[] = {0, 0, 0, 1, 1, 1, 0, 1, 0, -1};
-int T1D3[] = {0, 1, 0, 1, 1, 0, 0, 1, 0, -1};
-
-int T2D0[] = {1, 0, 0, 1, 1, 1, 0, 0, 0, -1};
-int T2D1[] = {0, 1, 1, 0, 1, 0, 0, 1, 0, -1};
-int T2D2[] = {0, 0, 0, 1, 1, 1, 0, 0, 1, -1};
-int T2D3[] = {0, 1, 0, 0, 1, 0, 1, 1, 0, -1};
-
-int T3D0[] = {0, 0, 1, 1, 1, 1, 0, 0, 0, -1};
-int T3D1[] = {0, 1, 0, 0, 1, 0, 0, 1, 1, -1};
-int T3D2[] = {0, 0, 0, 1, 1, 1, 1, 0, 0, -1};
-int T3D3[] = {1, 1, 0, 0, 1, 0, 0, 1, 0, -1};
-
-int T4D0[] = {0, 1, 0, 1, 1, 0, 1, 0, 0, -1};
-int T4D1[] = {1, 1, 0, 0, 1, 1, 0, 0, 0, -1};
-int T4D2[] = {0, 1, 0, 1, 1, 0, 1, 0, 0, -1};
-int T4D3[] = {1, 1, 0, 0, 1, 1, 0, 0, 0, -1};
-
-int T5D0[] = {0, 1, 0, 0, 1, 1, 0, 0, 1, -1};
-int T5D1[] = {0, 0, 0, 0, 1, 1, 1, 1, 0, -1};
-int T5D2[] = {0, 1, 0, 0, 1, 1, 0, 0, 1, -1};
-int T5D3[] = {0, 0, 0, 0, 1, 1, 1, 1, 0, -1};
-
-int T6D0[] = {0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, -1};
-int T6D1[] = {0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, -1};
-int T6D2[] = {0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, -1};
-int T6D3[] = {0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, -1};
-
-int *setOfBlockArrays[] = {
-        T0D0, T0D1, T0D2, T0D3,
-        T1D0, T1D1, T1D2, T1D3,
-        T2D0, T2D1, T2D2, T2D3,
-        T3D0, T3D1, T3D2, T3D3,
-        T4D0, T4D1, T4D2, T4D3,
-        T5D0, T5D1, T5D2, T5D3,
-        T6D0, T6D1, T6D2, T6D3,
-};
-
-void drawScreen(Matrix *screen, int wall_depth) {
+
+// Render thread version of drawScreen: the game thread may hold the tty in
+// raw mode (no output post-processing) while we draw, so lines end in \r\n,
+// and the whole frame goes out in a single write.
+void drawScreenRaw(Matrix *screen, int wall_depth) {
+    PerfScope perf(PERF_DRAW);
+    TraceSpan span("drawScreen");
     int dy = screen->get_dy();
     int dx = screen->get_dx();
     int dw = wall_depth;
     int **array = screen->get_array();
+    string frame;
 
     for (int y = 0; y < dy - dw + 1; y++) {
-        for (int x = dw - 1; x < dx - dw + 1; x++) {
-            if (array[y][x] == 0)
-                cout << "□ ";
-            else if (array[y][x] == 1)
-                cout << "■ ";
-            else if (array[y][x] == 10)
-                cout << "◈ ";
-            else if (array[y][x] == 20)
-                cout << "★ ";
-            else if (array[y][x] == 30)
-                cout << "● ";
-            else if (array[y][x] == 40)
-                cout << "◆ ";
-            else if (array[y][x] == 50)
-                cout << "▲ ";
-            else if (array[y][x] == 60)
-                cout << "♣ ";
-            else if (array[y][x] == 70)
-                cout << "♥ ";
-            else
-                cout << "X ";
-        }
-        cout << endl;
+        for (int x = dw - 1; x < dx - dw + 1; x++)
+            frame += cellSymbol(array[y][x]);
+        frame += "\r\n";
     }
+    cout << frame << flush;
 }
 
 /**************************************************************/
 /******************** Tetris Main Loop ************************/
 /**************************************************************/
 
-#define SCREEN_DY  10
-#define SCREEN_DX  10
-#define SCREEN_DW  4
-
-#define ARRAY_DY (SCREEN_DY + SCREEN_DW)
-#define ARRAY_DX (SCREEN_DX + 2*SCREEN_DW)
-
-int arrayScreen[ARRAY_DY][ARRAY_DX] = {
-        {1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1},
-        {1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1},
-        {1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1},
-        {1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1},
-        {1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1},
-        {1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1},
-        {1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1},
-        {1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1},
-        {1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1},
-        {1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1},
-        {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
-        {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
-        {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
-        {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
-};
-
-void deleteFullLines(Matrix *gameMap, int top, int left, int blockHeight) {
-//    gameMap->print();
-//    cout << "top : " << top << endl;
-//    cout << "left : " << left << endl;
-//    cout << "blockHeight : " << blockHeight << endl;
-
-    int **arrayGameMap = gameMap->get_array();
-
-//    cout << "탐색해야 하는 위로부터의 거리" << endl;
-    for (int i = top; i < top + blockHeight; ++i) {
-        if (i > SCREEN_DY - 1) {
-            break;
-        }
-//        cout << i << endl;
-
-        bool isFull = true;
-        for (int j = 0; j < ARRAY_DX; ++j) {
-//            cout << arrayGameMap[i][j] << " ";
-            if (arrayGameMap[i][j] == 0) {
-                isFull = false;
-            }
-        }
-//        cout << endl << "isFull? " << isFull << endl;
-        if (isFull) {
-            Matrix *tempBackground = gameMap->clip(0, 0, i, ARRAY_DX);
-//            tempBackground->print();
-            gameMap->paste(tempBackground, 1, 0);
-            delete tempBackground;
-//            gameMap->print();
-        }
+Broadcaster broadcaster; // -b <name> : publish frames to local spectators
+const char *snapshotPath = NULL; // -s <path> : 'z' key saves the game there and quits
+Renderer renderer;               // -a : draw frames on a separate thread
+BoardHistory history;            // 'u' / 'r' : undo and redo placed blocks (practice)
+
+void showScreen(Matrix *screen) {
+    if (renderer.isRunning()) {
+        // 실제 그리기는 렌더 스레드의 drawScreenRaw에서 잼
+        TraceSpan span("submit frame");
+        renderer.submit(screen);
+        broadcaster.publish(screen);
+        return;
     }
+    PerfScope perf(PERF_DRAW);
+    TraceSpan span("drawScreen");
+    drawScreen(screen, SCREEN_DW);
+    broadcaster.publish(screen);
 }
 
-bool checkIsTouchedTop(Matrix *gameMap) {
-    int **arrayGameMap = gameMap->get_array();
+// 렌더 스레드가 도는 동안에는 메시지도 렌더 스레드가 찍음
+void showMessage(const string &message) {
+    if (renderer.isRunning())
+        renderer.print(message);
+    else
+        cout << message << endl;
+}
 
-    bool isTopOccupied = false;
-    for (int i = SCREEN_DW; i < SCREEN_DX + SCREEN_DW; ++i) {
-//        cout << arrayGameMap[0][i] << " ";
-        if (arrayGameMap[0][i] == 1) {
-            isTopOccupied = true;
-            break;
-        }
-    }
-//    cout << endl;
-    if (isTopOccupied) {
-        return true;
-    }
-    else {
-        return false;
-    }
+// 지금 블럭이 나온 순간의 게임 상태를 board와 함께 기록
+void recordVersion(Tetris *tetris, const PersistentBoard &board) {
+    BoardVersion version;
+    version.board = board;
+    version.blockType = tetris->get_blockType();
+    version.blockDegree = tetris->get_idxBlockDegree();
+    version.score = tetris->get_score();
+    version.nBlocks = tetris->get_nBlocks();
+    version.rngSeed = tetris->get_rngSeed();
+    history.commit(version);
 }
 
-int getSideLength(int arr[]) {
-    int i = 0;
-    int counter = 0;
-    while (arr[i] != -1) {
-        counter++;
-        i++;
-    }
-    return sqrt(counter);
+void stopRenderer() {
+    if (!renderer.isRunning())
+        return;
+    renderer.stop();
+    cout << "(frames drawn, dropped) = (" << renderer.get_nDrawn() << "," << renderer.get_nDropped() << ")" << endl;
 }
 
-#define INIT_TOP 0
-#define INIT_LEFT 8
+void finishProfiling() {
+    PerfCounters::report(cout);
+    PerfCounters::close();
+    Trace::close();
+}
 
 int main(int argc, char *argv[]) {
 //    Matrix* list[7][4];
@@ -288,206 +196,126 @@ int main(int argc, char *argv[]) {
 //    return 0;
 
 
-    char key;
-    int top = INIT_TOP, left = INIT_LEFT;
-    int blockType;
-    int idxBlockDegree = 0;
-    bool newBlockNeeded = false;
-
-    srand((unsigned int) time(NULL));
-
-    Matrix *iScreen = new Matrix((int *) arrayScreen, ARRAY_DY, ARRAY_DX);
-    Matrix *setOfBlockObjects[MAX_BLK_TYPES][MAX_BLK_DEGREES];
-
-    for (int i = 0; i < MAX_BLK_TYPES; i++) {
-        for (int j = 0; j < MAX_BLK_DEGREES; j++) {
-            int sideLength = getSideLength(setOfBlockArrays[i * MAX_BLK_DEGREES + j]);
-            setOfBlockObjects[i][j] = new Matrix(setOfBlockArrays[i * MAX_BLK_DEGREES + j], sideLength, sideLength);
+    int opt;
+    const char *resumePath = NULL;
+    const char *blocksPath = NULL;
+    bool asyncDraw = false;
+    while ((opt = getopt(argc, argv, "ab:k:Ps:r:t:")) != -1) {
+        switch (opt) {
+            case 'a':
+                asyncDraw = true;
+                break;
+            case 'b':
+                if (!broadcaster.open(optarg, SCREEN_DW))
+                    return 1;
+                break;
+            case 'k':
+                blocksPath = optarg;
+                break;
+            case 'P':
+                PerfCounters::open();
+                break;
+            case 't':
+                if (!Trace::open(optarg))
+                    return 1;
+                break;
+            case 's':
+                snapshotPath = optarg;
+                break;
+            case 'r':
+                resumePath = optarg;
+                break;
+            default:
+                cerr << "usage: " << argv[0] << " [-a] [-b broadcast_name] [-k blocks_file] [-P] [-s save_path] [-r resume_path] [-t trace.json]" << endl;
+                return 1;
         }
     }
 
-//    for (int i = 0; i < MAX_BLK_TYPES; ++i) {
-//        for (int j = 0; j < MAX_BLK_DEGREES; ++j) {
-//            delete setOfBlockObjects[i][j];
-//        }
-//    }
-//    delete iScreen;
-//
-//    cout << "(nAlloc, nFree, alloc-free) = (" << Matrix::get_nAlloc() << ',' << Matrix::get_nFree() << ","
-//         << Matrix::get_nAlloc() - Matrix::get_nFree() << ")" << endl;
-//    cout << "Program terminated!" << endl;
-//
-//    return 0;
-
-
-    blockType = rand() % MAX_BLK_TYPES;
-    Matrix *currBlk = setOfBlockObjects[blockType][idxBlockDegree];
-    Matrix *tempBackground = iScreen->clip(top, left, top + currBlk->get_dy(), left + currBlk->get_dx());
-    Matrix *addedBlk = tempBackground->add(currBlk);
+    char key;
+    Matrix *setOfBlockObjects[MAX_BLK_TYPES][MAX_BLK_DEGREES];
+    if (blocksPath == NULL)
+        createBlockObjects(setOfBlockObjects);
+    else if (!loadBlockObjects(blocksPath, setOfBlockObjects))
+        return 1;
 
-    Matrix *oScreen = new Matrix(iScreen);
-    oScreen->paste(addedBlk, top, left);
+    // 렌더 스레드가 화면을 그리는 동안 게임 스레드는 터미널에 직접 쓰지 않음
+    Tetris *tetris = new Tetris(setOfBlockObjects, (unsigned int) time(NULL), !asyncDraw);
+    if ((resumePath != NULL) && !tetris->load(resumePath))
+        return 1;
 
     cout << "(nAlloc, nFree, diff)" << Matrix::get_nAlloc() << " " << Matrix::get_nFree() << " "
          << Matrix::get_nAlloc() - Matrix::get_nFree() << endl;
 
-    drawScreen(oScreen, SCREEN_DW);
+    // 렌더 스레드는 게임 스레드가 터미널에 다 쓴 뒤에 시작
+    if (asyncDraw)
+        renderer.start(ARRAY_DY, ARRAY_DX, SCREEN_DW, drawScreenRaw);
+
+    recordVersion(tetris, PersistentBoard(tetris->get_iScreen()));
+    showScreen(tetris->get_oScreen());
 
     // (게임 루프)
     while ((key = getch()) != 'q') { // 종료 키 q
-        // 새로운 블록이 필요하다면,
-        if (newBlockNeeded) {
-//            cout << "NEW BLOCK NEEDED!!!" << endl;
-
-            delete iScreen;
-            iScreen = new Matrix(oScreen);
+        PerfScope perfFrame(PERF_FRAME);
+        TraceSpan traceFrame("frame");
 
-            deleteFullLines(iScreen, top, left, currBlk->get_dy());
-            if(checkIsTouchedTop(iScreen)) {
-                cout << "GAME OVER" << endl;
-                return 0;
-            }
-
-            top = INIT_TOP;
-            left = INIT_LEFT;
-
-            blockType = rand() % MAX_BLK_TYPES;
-            currBlk = setOfBlockObjects[blockType][idxBlockDegree];
-
-            newBlockNeeded = false;
+        // 새로운 블록이 필요하다면,
+        bool landed = tetris->isNewBlockNeeded() && !tetris->isGameOver();
+        Matrix *landedBlk = tetris->get_currBlk();
+        int landedTop = tetris->get_top();
+        int landedLeft = tetris->get_left();
+        if (!tetris->lockBlock()) {
+            stopRenderer();
+            finishProfiling();
+            cout << "GAME OVER" << endl;
+            cout << "score : " << tetris->get_score() << endl;
+            return 0;
+        }
+        if (landed) {
+            // 직전 판에서 블럭이 닿은 줄만 새로 만들고 나머지 줄은 공유
+            int nDeleted;
+            PersistentBoard board = history.current().board.place(landedBlk, landedTop, landedLeft)
+                                        .deleteFullLines(landedTop, landedBlk->get_dy(), SCREEN_DY, &nDeleted);
+            recordVersion(tetris, board);
         }
 
-        // 디버깅용 메모리 추적
-//        cout << "(nAlloc, nFree, diff)" << Matrix::get_nAlloc() << " " << Matrix::get_nFree() << " "
-//             << Matrix::get_nAlloc() - Matrix::get_nFree() << endl;
-
-        // 입력 처리
-        switch (key) {
-            case 'a':
-                left--;
-                break;
-            case 'd':
-                left++;
-                break;
-            case 's':
-                top++;
-                break;
-            case 'w':
-                break;
-            case 'p':
-                idxBlockDegree++;
-                if (idxBlockDegree > MAX_BLK_DEGREES - 1) {
-                    idxBlockDegree = 0;
-                }
-                currBlk = setOfBlockObjects[blockType][idxBlockDegree];
-                break;
-            case 'l':
-                idxBlockDegree--;
-                if (idxBlockDegree < 0) {
-                    idxBlockDegree = MAX_BLK_DEGREES - 1;
-                }
-                currBlk = setOfBlockObjects[blockType][idxBlockDegree];
-                break;
-            case ' ':
-                do {
-                    // 내려감
-                    top++;
-
-                    // 임시 백그라운드에 현재 블럭을 더해서 addedBlk를 만듬, 더하고 생각하기
-                    delete tempBackground;
-                    tempBackground = iScreen->clip(top, left, top + currBlk->get_dy(), left + currBlk->get_dx());
-                    delete addedBlk;
-                    addedBlk = tempBackground->add(currBlk);
-
-                } while (!addedBlk->anyGreaterThan(1)); // 충돌체크
-                break;
-            default:
-                cout << "wrong key input" << endl;
+        // 되돌리기, 다시하기
+        if ((key == 'u') || (key == 'r')) {
+            BoardVersion version;
+            if ((key == 'u') ? history.undo(&version) : history.redo(&version))
+                tetris->restore(version);
+            showScreen(tetris->get_oScreen());
+            continue;
         }
 
-        // 임시 백그라운드에 현재 블럭을 더해서 addedBlk를 만듬, 허락보다 용서가 쉽다
-        delete tempBackground;
-        tempBackground = iScreen->clip(top, left, top + currBlk->get_dy(), left + currBlk->get_dx());
-        delete addedBlk;
-        addedBlk = tempBackground->add(currBlk);
-
-        // 충돌처리, 이전으로 돌리고, 사후처리
-        if (addedBlk->anyGreaterThan(1)) {
-            cout << "충돌발생!!!" << endl;
-            cout << "top : " << top << endl;
-            cout << "left : " << left << endl;
-
-            switch (key) {
-                case 'a':
-                    left++;
-                    break;
-                case 'd':
-                    left--;
-                    break;
-                case 's':
-                    top--;
-                    newBlockNeeded = true; // 새로운 블록 필요
-                    break;
-                case 'p':
-                    idxBlockDegree--;
-                    if (idxBlockDegree < 0) {
-                        idxBlockDegree = MAX_BLK_DEGREES - 1;
-                    }
-                    currBlk = setOfBlockObjects[blockType][idxBlockDegree];
-                    break;
-                case 'l':
-                    idxBlockDegree++;
-                    if (idxBlockDegree > MAX_BLK_DEGREES - 1) {
-                        idxBlockDegree = 0;
-                    }
-                    currBlk = setOfBlockObjects[blockType][idxBlockDegree];
-                    break;
-                case 'w':
-                    break;
-                case ' ':
-                    top--;
-                    newBlockNeeded = true; // 새로운 블록 필요
-                    break;
+        // 게임 저장 후 종료
+        if (key == 'z') {
+            if (snapshotPath == NULL) {
+                showMessage("no save path, run with -s <path>");
+                continue;
             }
-
-            // 사후처리 : 임시 백그라운드에 현재 블럭을 더해서 addedBlk를 만듬
-            delete tempBackground;
-            tempBackground = iScreen->clip(top, left, top + currBlk->get_dy(), left + currBlk->get_dx());
-            delete addedBlk;
-            addedBlk = tempBackground->add(currBlk);
+            if (tetris->save(snapshotPath)) {
+                showMessage(string("game saved to ") + snapshotPath);
+                break;
+            }
+            continue;
         }
 
-        // 화면 그려주기
-        delete oScreen;
-        oScreen = new Matrix(iScreen);
-        oScreen->paste(addedBlk, top, left);
-        drawScreen(oScreen, SCREEN_DW);
+        tetris->handleKey(key);
+        showScreen(tetris->get_oScreen());
+        Trace::counter("Matrix live", Matrix::get_nAlloc() - Matrix::get_nFree());
     }
 
-    delete iScreen;
-//    delete currBlk; // 이거 없애면 됨. 왜 그냥 참조를 delete하려 한거야
-    delete tempBackground;
-    delete addedBlk;
-    delete oScreen;
-
+    stopRenderer();
+    finishProfiling();
 
-//    for (int i = 0; i < MAX_BLK_TYPES; ++i) {
-//        for (int j = 0; j < MAX_BLK_DEGREES; ++j) {
-//            cout << "i : " << i << ", j : " << j << endl;
-//            setOfBlockObjects[i][j]->print();
-//            cout << endl;
-//        }
-//    }
-
-    for (int i = 0; i < MAX_BLK_TYPES; i++) {
-        for (int j = 0; j < MAX_BLK_DEGREES; j++) {
-            delete setOfBlockObjects[i][j];
-        }
-    }
+    delete tetris;
+    deleteBlockObjects(setOfBlockObjects);
 
 
     cout << "(nAlloc, nFree, alloc-free) = (" << Matrix::get_nAlloc() << ',' << Matrix::get_nFree() << ","
          << Matrix::get_nAlloc() - Matrix::get_nFree() << ")" << endl;
+    cout << "(board versions, rows alloc, rows free) = (" << history.size() << "," << PersistentBoard::get_nRowAlloc()
+         << "," << PersistentBoard::get_nRowFree() << ")" << endl;
     cout << "Program terminated!" << endl;
 
     return 0;
@@ -1,12 +1,158 @@
+#include <string.h>
+#include <mutex>
 #include "Matrix.h"
+#include "Scheduler.h"
 
-int Matrix::nAlloc = 0;
-int Matrix::nFree = 0;
+std::atomic<int> Matrix::nAlloc(0);
+std::atomic<int> Matrix::nFree(0);
 
 int Matrix::get_nAlloc() { return nAlloc; }
 
 int Matrix::get_nFree() { return nFree; }
 
+/**************************************************************/
+/******************** Parallel execution **********************/
+/**************************************************************/
+
+// Matrix has a pool of its own: an operation called from a body running on
+// another scheduler's parallelFor must not wait on that same scheduler.
+static int parallelThreads = 0;
+static std::atomic<long> parallelMinCells(MATRIX_PARALLEL_MIN_CELLS);
+static TaskScheduler *parallelPool = NULL;
+static std::mutex parallelPoolLock;
+
+static struct ParallelPoolCleanup {
+  ~ParallelPoolCleanup() { delete parallelPool; }
+} parallelPoolCleanup;
+
+static TaskScheduler *getParallelPool() {
+  lock_guard<std::mutex> guard(parallelPoolLock);
+  if (parallelPool == NULL)
+    parallelPool = new TaskScheduler(parallelThreads);
+  return parallelPool;
+}
+
+// not to be called while another thread runs a large Matrix operation
+void Matrix::setParallel(int nThreads, long minCells) {
+  lock_guard<std::mutex> guard(parallelPoolLock);
+  delete parallelPool;   // the next large operation starts one of the new size
+  parallelPool = NULL;
+  parallelThreads = nThreads;
+  parallelMinCells = minCells;
+}
+
+long Matrix::get_parallelMinCells() { return parallelMinCells; }
+
+// body(y0, y1, worker) over the rows [0, cy) of a cy x cx operation.
+// Small operations call body once, inline; large ones hand out chunks of
+// rows, a few per worker so that stealing can even out the load.
+template <class F>
+static void forRows(int cy, int cx, F body) {
+  long minCells = parallelMinCells.load(memory_order_relaxed);
+  if ((minCells <= 0) || ((long) cy * cx < minCells) || (cy < 2)) {
+    body(0, cy, 0);
+    return;
+  }
+  TaskScheduler *pool = getParallelPool();
+  long grain = max(1L, (long) cy / (pool->get_nThreads() * 4));
+  pool->parallelFor(0, cy, grain, function<void(long, long, int)>(body));
+}
+
+static void copyRows(int **dst, int dstLeft, int **src, int srcLeft, int cy, int cx) {
+  forRows(cy, cx, [=](long y0, long y1, int) {
+    for (long y = y0; y < y1; y++)
+      memcpy(dst[y] + dstLeft, src[y] + srcLeft, cx * sizeof(int));
+  });
+}
+
+// out = a + b, cell by cell; out may be a or b
+static void addRows(int **out, int **a, int aLeft, int **b, int bLeft, int cy, int cx) {
+  forRows(cy, cx, [=](long y0, long y1, int) {
+    for (long y = y0; y < y1; y++) {
+      int *pa = a[y] + aLeft;
+      int *pb = b[y] + bLeft;
+      for (int x = 0; x < cx; x++)
+        out[y][x] = pa[x] + pb[x];
+    }
+  });
+}
+
+// partial sums are added in whatever order the chunks finish; they are kept
+// unsigned, where overflow is defined to wrap, so the order does not matter
+static int sumRows(int **rows, int left, int cy, int cx) {
+  std::atomic<unsigned int> total(0);
+  forRows(cy, cx, [&](long y0, long y1, int) {
+    unsigned int partial = 0;
+    for (long y = y0; y < y1; y++) {
+      int *src = rows[y] + left;
+      for (int x = 0; x < cx; x++)
+        partial += (unsigned int) src[x];
+    }
+    total.fetch_add(partial, memory_order_relaxed);
+  });
+  return (int) total.load();
+}
+
+// once a chunk finds a cell, the others stop at their next row
+static bool anyGreaterRows(int **rows, int left, int cy, int cx, int val) {
+  std::atomic<bool> found(false);
+  forRows(cy, cx, [&](long y0, long y1, int) {
+    for (long y = y0; (y < y1) && !found.load(memory_order_relaxed); y++) {
+      int *src = rows[y] + left;
+      for (int x = 0; x < cx; x++) {
+        if (src[x] > val) {
+          found.store(true, memory_order_relaxed);
+          break;
+        }
+      }
+    }
+  });
+  return found;
+}
+
+// Transposes and rotations work on tiles of MATRIX_TILE x MATRIX_TILE
+// cells: one tile of the source rows and one of the destination rows stay in
+// cache while it is copied, and the innermost loop writes consecutive cells.
+#define MATRIX_TILE 32
+
+// dst[x][y] = src[y][x] for a cy x cx source
+static void transposeRows(int **dst, int **src, int cy, int cx) {
+  forRows(cx, cy, [=](long x0, long x1, int) {
+    for (long tx = x0; tx < x1; tx += MATRIX_TILE) {
+      long xEnd = min(x1, tx + MATRIX_TILE);
+      for (int ty = 0; ty < cy; ty += MATRIX_TILE) {
+        int yEnd = min(cy, ty + MATRIX_TILE);
+        for (long x = tx; x < xEnd; x++) {
+          int *d = dst[x];
+          for (int y = ty; y < yEnd; y++)
+            d[y] = src[y][x];
+        }
+      }
+    }
+  });
+}
+
+// dst[y][cx - 1 - x] = src[y][x]; dst may be src
+static void reverseRows(int **dst, int **src, int cy, int cx) {
+  forRows(cy, cx, [=](long y0, long y1, int) {
+    for (long y = y0; y < y1; y++) {
+      int *s = src[y];
+      int *d = dst[y];
+      for (int x = 0; x < cx / 2; x++) {
+        int temp = s[x];
+        d[x] = s[cx - 1 - x];
+        d[cx - 1 - x] = temp;
+      }
+      if (cx % 2)
+        d[cx / 2] = s[cx / 2];
+    }
+  });
+}
+
+/**************************************************************/
+/************************** Matrix ****************************/
+/**************************************************************/
+
 int Matrix::get_dy() const { return dy; }
 
 int Matrix::get_dx() const { return dx; }
@@ -61,16 +207,12 @@ Matrix::Matrix(int cy, int cx, int val) {
 
 Matrix::Matrix(const Matrix *obj) {
   alloc(obj->dy, obj->dx);
-  for (int y = 0; y < dy; y++)
-    for (int x = 0; x < dx; x++)
-      array[y][x] = obj->array[y][x];
+  copyRows(array, 0, obj->array, 0, dy, dx);
 }
 
 Matrix::Matrix(const Matrix &obj) {
   alloc(obj.dy, obj.dx);
-  for (int y = 0; y < dy; y++)
-    for (int x = 0; x < dx; x++)
-      array[y][x] = obj.array[y][x];
+  copyRows(array, 0, obj.array, 0, dy, dx);
 }
 
 Matrix::Matrix(int *arr, int row, int col) {
@@ -80,6 +222,11 @@ Matrix::Matrix(int *arr, int row, int col) {
       array[y][x] = arr[y * dx + x];
 }
 
+Matrix::Matrix(const MatrixView &obj) {
+  alloc(obj.get_dy(), obj.get_dx());
+  copyRows(array, 0, obj.get_rows(), obj.get_left(), dy, dx);
+}
+
 Matrix *Matrix::clip(int top, int left, int bottom, int right) {
   int cy = bottom - top;
   int cx = right - left;
@@ -117,6 +264,16 @@ Matrix Matrix::clip_(int top, int left, int bottom, int right) {
   return temp;
 }
 
+MatrixView Matrix::view(int top, int left, int bottom, int right) const {
+  // the whole region is checked here, so users of the view never check per cell
+  if ((top < 0) || (left < 0) || (bottom > dy) || (right > dx) ||
+      (top > bottom) || (left > right)) {
+    cerr << "invalid matrix range" << endl;
+    return MatrixView();
+  }
+  return MatrixView(array + top, left, bottom - top, right - left);
+}
+
 void Matrix::paste(const Matrix *obj, int top, int left) {
   for (int y = 0; y < obj->dy; y++)
     for (int x = 0; x < obj->dx; x++) {
@@ -141,6 +298,23 @@ void Matrix::paste(const Matrix &obj, int top, int left) {
     }
 }
 
+void Matrix::paste(const MatrixView &obj, int top, int left) {
+  int cy = obj.get_dy();
+  int cx = obj.get_dx();
+  if ((top < 0) || (left < 0) || (top + cy > dy) || (left + cx > dx)) {
+    cerr << "invalid matrix range" << endl;
+    return;
+  }
+  int **rows = obj.get_rows();
+  int srcLeft = obj.get_left();
+  // a view of this very matrix moved downwards must be copied bottom-up
+  bool bottomUp = (rows >= array) && (rows < array + dy) && (rows - array < top);
+  for (int i = 0; i < cy; i++) {
+    int y = bottomUp ? cy - 1 - i : i;
+    memmove(array[top + y] + left, rows[y] + srcLeft, cx * sizeof(int));
+  }
+}
+
 Matrix *Matrix::add(const Matrix *obj) {
   if ((dx != obj->dx) || (dy != obj->dy)) {
       cout << "will return null!" << endl;
@@ -149,19 +323,27 @@ Matrix *Matrix::add(const Matrix *obj) {
       return NULL;
   }
   Matrix *temp = new Matrix(dy, dx);
-  for (int y = 0; y < dy; y++)
-    for (int x = 0; x < dx; x++)
-      temp->array[y][x] = array[y][x] + obj->array[y][x];
+  addRows(temp->array, array, 0, obj->array, 0, dy, dx);
+  return temp;
+}
+
+Matrix *Matrix::add(const MatrixView &obj) {
+  if ((dx != obj.get_dx()) || (dy != obj.get_dy())) {
+      cout << "will return null!" << endl;
+      cout << "because dx : " << dx << " obj.dx : " << obj.get_dx() << endl;
+      cout << "because dy : " << dy << " obj.dy : " << obj.get_dy() << endl;
+      return NULL;
+  }
+  Matrix *temp = new Matrix(dy, dx);
+  addRows(temp->array, array, 0, obj.get_rows(), obj.get_left(), dy, dx);
   return temp;
 }
 
 const Matrix operator+(const Matrix& m1, const Matrix& m2) { // friend function version of operator+ overloading
   if ((m1.dx != m2.dx) || (m1.dy != m2.dy)) return Matrix();
   Matrix temp(m1.dy, m1.dx);
-  for (int y = 0; y < m1.dy; y++)
-    for (int x = 0; x < m1.dx; x++)
-      temp.array[y][x] = m1.array[y][x] + m2.array[y][x];
-  return temp;  
+  addRows(temp.array, m1.array, 0, m2.array, 0, m1.dy, m1.dx);
+  return temp;
 }
 
 // const Matrix Matrix::operator+(const Matrix& m2) const  { // member function version of operator+ overloading
@@ -173,40 +355,122 @@ const Matrix operator+(const Matrix& m1, const Matrix& m2) { // friend function
 //   return temp;  
 // }
 
-int Matrix::sum() {
-  int total = 0;
-  for (int y = 0; y < dy; y++)
-    for (int x = 0; x < dx; x++)
-      total += array[y][x];
-  return total;
-}
+int Matrix::sum() { return sumRows(array, 0, dy, dx); }
 
 void Matrix::mulc(int coef) {
-  for (int y = 0; y < dy; y++)
-    for (int x = 0; x < dx; x++)
-      array[y][x] = coef * array[y][x];
+  int **a = array;
+  int cx = dx;
+  forRows(dy, dx, [=](long y0, long y1, int) {
+    for (long y = y0; y < y1; y++)
+      for (int x = 0; x < cx; x++)
+        a[y][x] = coef * a[y][x];
+  });
 }
 
 Matrix *Matrix::int2bool() {
   Matrix *temp = new Matrix(dy, dx);
   int **t_array = temp->get_array();
-  for (int y = 0; y < dy; y++)
-    for (int x = 0; x < dx; x++)
-      t_array[y][x] = (array[y][x] != 0 ? 1 : 0);
+  int **a = array;
+  int cx = dx;
+  forRows(dy, dx, [=](long y0, long y1, int) {
+    for (long y = y0; y < y1; y++)
+      for (int x = 0; x < cx; x++)
+        t_array[y][x] = (a[y][x] != 0 ? 1 : 0);
+  });
   
   return temp;
 }
 
-bool Matrix::anyGreaterThan(int val) {
-  for (int y = 0; y < dy; y++) {
-    for (int x = 0; x < dx; x++) {
-      if (array[y][x] > val)
-	return true;
+bool Matrix::anyGreaterThan(int val) { return anyGreaterRows(array, 0, dy, dx, val); }
+
+// this gets obj's cells and shape, obj gets ours and is deleted
+void Matrix::takeOver(Matrix *obj) {
+  swap(dy, obj->dy);
+  swap(dx, obj->dx);
+  swap(array, obj->array);
+  delete obj;
+}
+
+// The rotations are transposes of the same rows taken in another order:
+// with a row table, reordering rows only moves pointers.
+Matrix *Matrix::transpose() const {
+  Matrix *temp = new Matrix(dx, dy);
+  transposeRows(temp->array, array, dy, dx);
+  return temp;
+}
+
+Matrix *Matrix::rotate90() const {
+  Matrix *temp = new Matrix(dx, dy);
+  int **bottomUp = new int*[dy + 1];   // dy may be 0
+  for (int y = 0; y < dy; y++)
+    bottomUp[y] = array[dy - 1 - y];
+  transposeRows(temp->array, bottomUp, dy, dx);
+  delete[] bottomUp;
+  return temp;
+}
+
+Matrix *Matrix::rotate270() const {
+  Matrix *temp = new Matrix(dx, dy);
+  int **bottomUp = new int*[dx + 1];
+  for (int x = 0; x < dx; x++)
+    bottomUp[x] = temp->array[dx - 1 - x];
+  transposeRows(bottomUp, array, dy, dx);
+  delete[] bottomUp;
+  return temp;
+}
+
+Matrix *Matrix::rotate180() const {
+  Matrix *temp = new Matrix(dy, dx);
+  int **bottomUp = new int*[dy + 1];
+  for (int y = 0; y < dy; y++)
+    bottomUp[y] = temp->array[dy - 1 - y];
+  reverseRows(bottomUp, array, dy, dx);
+  delete[] bottomUp;
+  return temp;
+}
+
+Matrix *Matrix::flip() const {
+  Matrix *temp = new Matrix(dy, dx);
+  reverseRows(temp->array, array, dy, dx);
+  return temp;
+}
+
+void Matrix::transposeInPlace() {
+  if (dy != dx) {
+    takeOver(transpose());
+    return;
+  }
+  // swap each tile above the diagonal with its mirror below
+  for (int ty = 0; ty < dy; ty += MATRIX_TILE) {
+    int yEnd = min(dy, ty + MATRIX_TILE);
+    for (int tx = ty; tx < dx; tx += MATRIX_TILE) {
+      int xEnd = min(dx, tx + MATRIX_TILE);
+      for (int y = ty; y < yEnd; y++)
+        for (int x = max(tx, y + 1); x < xEnd; x++)
+          swap(array[y][x], array[x][y]);
     }
   }
-  return false;
 }
 
+void Matrix::rotate90InPlace() {
+  transposeInPlace();
+  reverseRows(array, array, dy, dx);
+}
+
+void Matrix::rotate270InPlace() {
+  transposeInPlace();
+  for (int y = 0; y < dy / 2; y++)
+    swap(array[y], array[dy - 1 - y]);
+}
+
+void Matrix::rotate180InPlace() {
+  for (int y = 0; y < dy / 2; y++)
+    swap(array[y], array[dy - 1 - y]);
+  reverseRows(array, array, dy, dx);
+}
+
+void Matrix::flipInPlace() { reverseRows(array, array, dy, dx); }
+
 void Matrix::print() {
   cout << "Matrix(" << dy << "," << dx << ")" << endl;
   for (int y = 0; y < dy; y++) {
@@ -235,8 +499,59 @@ Matrix& Matrix::operator=(const Matrix& obj)
     if (array != NULL) dealloc();
     alloc(obj.dy, obj.dx);
   }
-  for (int y = 0; y < dy; y++)
-    for (int x = 0; x < dx; x++)
-      array[y][x] = obj.array[y][x];
+  copyRows(array, 0, obj.array, 0, dy, dx);
   return *this;
 }
+
+/**************************************************************/
+/************************ MatrixView **************************/
+/**************************************************************/
+
+MatrixView::MatrixView() {
+  rows = NULL;
+  left = 0;
+  dy = 0;
+  dx = 0;
+}
+
+MatrixView::MatrixView(int **rows, int left, int cy, int cx) {
+  this->rows = rows;
+  this->left = left;
+  dy = cy;
+  dx = cx;
+}
+
+int MatrixView::get_dy() const { return dy; }
+
+int MatrixView::get_dx() const { return dx; }
+
+int **MatrixView::get_rows() const { return rows; }
+
+int MatrixView::get_left() const { return left; }
+
+Matrix *MatrixView::add(const Matrix *obj) const {
+  if ((dx != obj->get_dx()) || (dy != obj->get_dy())) {
+      cout << "will return null!" << endl;
+      cout << "because dx : " << dx << " obj->dx : " << obj->get_dx() << endl;
+      cout << "because dy : " << dy << " obj->dy : " << obj->get_dy() << endl;
+      return NULL;
+  }
+  Matrix *temp = new Matrix(dy, dx);
+  addRows(temp->get_array(), rows, left, obj->get_array(), 0, dy, dx);
+  return temp;
+}
+
+int MatrixView::sum() const { return sumRows(rows, left, dy, dx); }
+
+bool MatrixView::anyGreaterThan(int val) const { return anyGreaterRows(rows, left, dy, dx, val); }
+
+ostream& operator<<(ostream& out, const MatrixView& obj){
+  out << "MatrixView(" << obj.dy << "," << obj.dx << ")" << endl;
+  for(int y = 0; y < obj.dy; y++){
+    for(int x = 0; x < obj.dx; x++)
+      out << obj.rows[y][obj.left + x] << " ";
+    out << endl;
+  }
+  out << endl;
+  return out;
+}
@@ -1,21 +1,56 @@
 #pragma once
 #include <iostream>
 #include <cstdlib>
+#include <atomic>
 
 using namespace std;
 
+class Matrix;
+template <class E> struct MatExpr;
+
+// Non-owning window onto a rectangular region of a Matrix.
+// A view keeps the parent's row table plus a column offset, so it is only
+// valid while the parent is alive and not reallocated.
+class MatrixView {
+private:
+  int **rows;
+  int left;
+  int dy;
+  int dx;
+public:
+  MatrixView();
+  MatrixView(int **rows, int left, int cy, int cx);
+  int get_dy() const;
+  int get_dx() const;
+  int **get_rows() const;
+  int get_left() const;
+  Matrix *add(const Matrix *obj) const;
+  int sum() const;
+  bool anyGreaterThan(int val) const;
+  friend ostream& operator<<(ostream& out, const MatrixView& obj);
+};
+
+// Row-parallel execution of the element-wise operations and reductions.
+// Matrices with at least minCells cells split their rows over a private
+// pool of nThreads workers (0: every core), created on first use. Anything
+// smaller, game boards included, runs the plain serial loop.
+#define MATRIX_PARALLEL_MIN_CELLS (1L << 16)
+
 class Matrix {
 private:
-  static int nAlloc;
-  static int nFree;
+  static std::atomic<int> nAlloc;   // atomic: games run on several threads
+  static std::atomic<int> nFree;
   int dy;
   int dx;
   int **array;
   void alloc(int cy, int cx);
   void dealloc();
+  void takeOver(Matrix *obj);
 public:
   static int get_nAlloc();
   static int get_nFree();
+  static void setParallel(int nThreads, long minCells);  // minCells <= 0: always serial
+  static long get_parallelMinCells();
   int get_dy() const;
   int get_dx() const;
   int** get_array() const;
@@ -25,19 +60,36 @@ public:
   Matrix(const Matrix &obj);
   Matrix(int *arr, int col, int row);
   Matrix(int cy, int cz, int val);
+  Matrix(const MatrixView &obj);
   ~Matrix();
   Matrix *clip(int top, int left, int bottom, int right);
   Matrix clip_(int top, int left, int bottom, int right);
+  MatrixView view(int top, int left, int bottom, int right) const;
   void paste(const Matrix *obj, int top, int left);
   void paste(const Matrix &obj, int top, int left);
+  void paste(const MatrixView &obj, int top, int left);
   Matrix *add(const Matrix *obj);
+  Matrix *add(const MatrixView &obj);
   friend const Matrix operator+(const Matrix& m1, const Matrix& m2);
 //  const Matrix operator+(const Matrix& m2) const;
   int sum();
   void mulc(int coef);
   Matrix *int2bool();
   bool anyGreaterThan(int val);
+  // clockwise quarter turns, left-right mirror and transpose; the in-place
+  // versions of the ones that change the shape reallocate unless square
+  Matrix *rotate90() const;
+  Matrix *rotate180() const;
+  Matrix *rotate270() const;
+  Matrix *flip() const;
+  Matrix *transpose() const;
+  void rotate90InPlace();
+  void rotate180InPlace();
+  void rotate270InPlace();
+  void flipInPlace();
+  void transposeInPlace();
   void print();
   friend ostream& operator<<(ostream& out, const Matrix& obj);
   Matrix& operator=(const Matrix& obj);
+  template <class E> Matrix& operator=(const MatExpr<E>& expr); // see MatrixExpr.h
 };
@@ -0,0 +1,168 @@
+#pragma once
+#include "Matrix.h"
+
+// Lazy Matrix arithmetic with expression templates.
+// lazy(m) wraps a Matrix or MatrixView; +, scalar *, > and int2bool build
+// expression objects without touching any cells. The cells are computed in
+// a single fused loop when the expression is reduced with any()/sum() or
+// assigned into a Matrix, so no intermediate Matrix is ever allocated.
+//
+//   bool hit = any(lazy(iScreen->view(top, left, bottom, right)) + lazy(*currBlk) > 1);
+//
+// Matrix + Matrix without lazy() is still the eager operator+.
+// Adding operands of different sizes gives an empty expression that is
+// marked mismatched; any() reports it as a hit, so a probe through an
+// invalid view counts as a collision instead of open space.
+
+template <class E>
+struct MatExpr {
+  const E &self() const { return static_cast<const E &>(*this); }
+  int get_dy() const { return self().get_dy(); }
+  int get_dx() const { return self().get_dx(); }
+  int at(int y, int x) const { return self().at(y, x); }
+  bool mismatched() const { return self().mismatched(); }
+};
+
+class MatLeaf : public MatExpr<MatLeaf> {
+private:
+  int **rows;
+  int left;
+  int dy;
+  int dx;
+public:
+  MatLeaf(const Matrix &m) : rows(m.get_array()), left(0), dy(m.get_dy()), dx(m.get_dx()) {}
+  MatLeaf(const MatrixView &v) : rows(v.get_rows()), left(v.get_left()), dy(v.get_dy()), dx(v.get_dx()) {}
+  int get_dy() const { return dy; }
+  int get_dx() const { return dx; }
+  int at(int y, int x) const { return rows[y][left + x]; }
+  bool mismatched() const { return false; }
+};
+
+template <class L, class R>
+class MatSum : public MatExpr<MatSum<L, R> > {
+private:
+  L l;
+  R r;
+  int dy;
+  int dx;
+  bool mismatch;
+public:
+  MatSum(const L &l, const R &r)
+      : l(l), r(r), dy(l.get_dy()), dx(l.get_dx()), mismatch(l.mismatched() || r.mismatched()) {
+    if ((dy != r.get_dy()) || (dx != r.get_dx())) {
+      cerr << "matrix size mismatch" << endl;
+      dy = 0;
+      dx = 0;
+      mismatch = true;
+    }
+  }
+  int get_dy() const { return dy; }
+  int get_dx() const { return dx; }
+  int at(int y, int x) const { return l.at(y, x) + r.at(y, x); }
+  bool mismatched() const { return mismatch; }
+};
+
+template <class E>
+class MatScale : public MatExpr<MatScale<E> > {
+private:
+  E e;
+  int coef;
+public:
+  MatScale(const E &e, int coef) : e(e), coef(coef) {}
+  int get_dy() const { return e.get_dy(); }
+  int get_dx() const { return e.get_dx(); }
+  int at(int y, int x) const { return coef * e.at(y, x); }
+  bool mismatched() const { return e.mismatched(); }
+};
+
+template <class E>
+class MatGreater : public MatExpr<MatGreater<E> > {
+private:
+  E e;
+  int val;
+public:
+  MatGreater(const E &e, int val) : e(e), val(val) {}
+  int get_dy() const { return e.get_dy(); }
+  int get_dx() const { return e.get_dx(); }
+  int at(int y, int x) const { return e.at(y, x) > val ? 1 : 0; }
+  bool mismatched() const { return e.mismatched(); }
+};
+
+template <class E>
+class MatBool : public MatExpr<MatBool<E> > {
+private:
+  E e;
+public:
+  MatBool(const E &e) : e(e) {}
+  int get_dy() const { return e.get_dy(); }
+  int get_dx() const { return e.get_dx(); }
+  int at(int y, int x) const { return e.at(y, x) != 0 ? 1 : 0; }
+  bool mismatched() const { return e.mismatched(); }
+};
+
+inline MatLeaf lazy(const Matrix &m) { return MatLeaf(m); }
+inline MatLeaf lazy(const MatrixView &v) { return MatLeaf(v); }
+
+template <class L, class R>
+MatSum<L, R> operator+(const MatExpr<L> &l, const MatExpr<R> &r) {
+  return MatSum<L, R>(l.self(), r.self());
+}
+
+template <class E>
+MatScale<E> operator*(const MatExpr<E> &e, int coef) { return MatScale<E>(e.self(), coef); }
+
+template <class E>
+MatScale<E> operator*(int coef, const MatExpr<E> &e) { return MatScale<E>(e.self(), coef); }
+
+template <class E>
+MatGreater<E> operator>(const MatExpr<E> &e, int val) { return MatGreater<E>(e.self(), val); }
+
+template <class E>
+MatBool<E> int2bool(const MatExpr<E> &e) { return MatBool<E>(e.self()); }
+
+// true if any cell of the expression is non-zero; stops at the first one.
+// A mismatched expression is true as well.
+template <class E>
+bool any(const MatExpr<E> &expr) {
+  const E &e = expr.self();
+  if (e.mismatched())
+    return true;
+  int dy = e.get_dy();
+  int dx = e.get_dx();
+  for (int y = 0; y < dy; y++)
+    for (int x = 0; x < dx; x++)
+      if (e.at(y, x) != 0)
+        return true;
+  return false;
+}
+
+template <class E>
+int sum(const MatExpr<E> &expr) {
+  const E &e = expr.self();
+  int dy = e.get_dy();
+  int dx = e.get_dx();
+  int total = 0;
+  for (int y = 0; y < dy; y++)
+    for (int x = 0; x < dx; x++)
+      total += e.at(y, x);
+  return total;
+}
+
+// cells only depend on the same position of their operands, so an
+// expression that reads the target itself is assigned in place when the
+// shape stays; a new shape is built aside first, as the expression may
+// still read the old rows
+template <class E>
+Matrix& Matrix::operator=(const MatExpr<E> &expr) {
+  const E &e = expr.self();
+  if ((dy != e.get_dy()) || (dx != e.get_dx())) {
+    Matrix *temp = new Matrix(e.get_dy(), e.get_dx());
+    *temp = expr;
+    takeOver(temp);
+    return *this;
+  }
+  for (int y = 0; y < dy; y++)
+    for (int x = 0; x < dx; x++)
+      array[y][x] = e.at(y, x);
+  return *this;
+}
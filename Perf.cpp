@@ -0,0 +1,166 @@
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <iomanip>
+
+#include "Matrix.h"
+#include "Perf.h"
+
+static const char *regionNames[PERF_NREGIONS] = {
+  "collision", "deleteFullLines", "drawScreen", "frame"
+};
+
+bool PerfCounters::enabled = false;
+int PerfCounters::leaderFd = -1;
+long PerfCounters::owner = -1;
+int PerfCounters::fds[PERF_NEVENTS];
+int PerfCounters::nOpened = 0;
+int PerfCounters::slot[PERF_NEVENTS];
+uint64_t PerfCounters::calls[PERF_NREGIONS];
+PerfSample PerfCounters::totals[PERF_NREGIONS];
+bool PerfCounters::uncounted[PERF_NREGIONS];
+
+static int openEvent(uint32_t type, uint64_t config, int groupFd) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = (groupFd == -1);
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP;
+  return syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0);
+}
+
+bool PerfCounters::open() {
+  static const uint32_t types[PERF_NEVENTS] = {
+    PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+    PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE
+  };
+  static const uint64_t configs[PERF_NEVENTS] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES
+  };
+
+  enabled = true;
+  memset(calls, 0, sizeof(calls));
+  memset(totals, 0, sizeof(totals));
+  memset(uncounted, 0, sizeof(uncounted));
+  owner = syscall(SYS_gettid);
+  leaderFd = -1;
+  nOpened = 0;
+  for (int i = 0; i < PERF_NEVENTS; i++) {
+    fds[i] = openEvent(types[i], configs[i], leaderFd);
+    slot[i] = -1;
+    if (fds[i] < 0) continue;   // not every CPU has every event
+    if (leaderFd == -1) leaderFd = fds[i];
+    slot[i] = nOpened++;
+  }
+  if (leaderFd == -1) {
+    cerr << "perf_event_open unavailable, timing only" << endl;
+    return false;
+  }
+  ioctl(leaderFd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(leaderFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  return true;
+}
+
+void PerfCounters::close() {
+  for (int i = 0; i < PERF_NEVENTS; i++) {
+    if (slot[i] >= 0) ::close(fds[i]);
+    slot[i] = -1;
+  }
+  leaderFd = -1;
+  nOpened = 0;
+  enabled = false;
+}
+
+bool PerfCounters::isEnabled() { return enabled; }
+
+bool PerfCounters::hasEvent(PerfEvent event) { return enabled && (slot[event] >= 0); }
+
+void PerfCounters::sample(PerfSample *s) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  s->ns = (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+  s->allocs = Matrix::get_nAlloc();
+
+  // one read() returns { nr, values[nr] } for the whole group
+  // the group counts the owner thread only, so other threads get no events
+  uint64_t buf[1 + PERF_NEVENTS];
+  s->counted = (syscall(SYS_gettid) == owner);
+  bool ok = s->counted && (leaderFd >= 0) && (read(leaderFd, buf, sizeof(buf)) > 0);
+  for (int i = 0; i < PERF_NEVENTS; i++)
+    s->events[i] = (ok && (slot[i] >= 0)) ? buf[1 + slot[i]] : 0;
+}
+
+void PerfCounters::account(PerfRegion region, const PerfSample &begin, const PerfSample &end) {
+  calls[region]++;
+  if (!begin.counted || !end.counted)
+    uncounted[region] = true;
+  totals[region].ns += end.ns - begin.ns;
+  totals[region].allocs += end.allocs - begin.allocs;
+  for (int i = 0; i < PERF_NEVENTS; i++)
+    totals[region].events[i] += end.events[i] - begin.events[i];
+}
+
+bool PerfCounters::counted(int region, PerfEvent event) { return !uncounted[region] && hasEvent(event); }
+
+void PerfCounters::report(ostream &out) {
+  if (!enabled) return;
+  out << "region            calls     ns/call  allocs/call";
+  if (leaderFd >= 0)
+    out << "  cycles/call  instr/call     IPC  L1D-miss/Ki  LLC-miss/Ki  br-miss/Ki";
+  out << endl;
+
+  for (int r = 0; r < PERF_NREGIONS; r++) {
+    if (calls[r] == 0) continue;
+    double n = (double) calls[r];
+    const uint64_t *ev = totals[r].events;
+    double kiloInstr = ev[PERF_INSTRUCTIONS] / 1000.0;
+
+    out << left << setw(16) << regionNames[r] << right << setw(8) << calls[r]
+        << fixed << setprecision(0) << setw(12) << totals[r].ns / n
+        << setprecision(2) << setw(13) << totals[r].allocs / n;
+    if (leaderFd >= 0) {
+      out << setprecision(0);
+      out << setw(13); if (counted(r, PERF_CYCLES)) out << ev[PERF_CYCLES] / n; else out << "-";
+      out << setw(12); if (counted(r, PERF_INSTRUCTIONS)) out << ev[PERF_INSTRUCTIONS] / n; else out << "-";
+      out << setprecision(2) << setw(8);
+      if (counted(r, PERF_CYCLES) && counted(r, PERF_INSTRUCTIONS) && ev[PERF_CYCLES] > 0)
+        out << (double) ev[PERF_INSTRUCTIONS] / ev[PERF_CYCLES];
+      else
+        out << "-";
+      PerfEvent misses[3] = { PERF_L1D_MISSES, PERF_LLC_MISSES, PERF_BRANCH_MISSES };
+      for (int i = 0; i < 3; i++) {
+        out << setw(i == 2 ? 12 : 13);
+        if (counted(r, misses[i]) && counted(r, PERF_INSTRUCTIONS) && kiloInstr > 0)
+          out << ev[misses[i]] / kiloInstr;
+        else
+          out << "-";
+      }
+    }
+    out << endl;
+  }
+  out.unsetf(ios::floatfield);
+}
+
+PerfScope::PerfScope(PerfRegion region) {
+  this->region = region;
+  if (PerfCounters::isEnabled())
+    PerfCounters::sample(&begin);
+}
+
+PerfScope::~PerfScope() {
+  if (!PerfCounters::isEnabled()) return;
+  PerfSample end;
+  PerfCounters::sample(&end);
+  PerfCounters::account(region, begin, end);
+}
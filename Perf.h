@@ -0,0 +1,69 @@
+#pragma once
+#include <stdint.h>
+#include <iostream>
+
+using namespace std;
+
+// Hardware performance counters around instrumented regions.
+// PerfCounters::open() sets up a Linux perf_event group for the calling
+// thread (cycles, instructions, L1D and LLC misses, branch mispredicts).
+// If the kernel refuses, regions are still timed with CLOCK_MONOTONIC.
+// Counters are per thread: only the thread that called open() is counted.
+// A region measured on another thread (the render thread under -a) is
+// timed only and its event columns are reported as "-".
+
+enum PerfRegion {
+  PERF_COLLISION,
+  PERF_DELETE_LINES,
+  PERF_DRAW,
+  PERF_FRAME,
+  PERF_NREGIONS
+};
+
+enum PerfEvent {
+  PERF_CYCLES,
+  PERF_INSTRUCTIONS,
+  PERF_L1D_MISSES,
+  PERF_LLC_MISSES,
+  PERF_BRANCH_MISSES,
+  PERF_NEVENTS
+};
+
+struct PerfSample {
+  uint64_t ns;
+  uint64_t allocs;
+  uint64_t events[PERF_NEVENTS];
+  bool counted;     // events were read on the thread that opened the group
+};
+
+class PerfCounters {
+private:
+  static bool enabled;
+  static int leaderFd;
+  static long owner;               // tid of the thread that called open()
+  static int fds[PERF_NEVENTS];
+  static int nOpened;
+  static int slot[PERF_NEVENTS];   // position of each event in a group read, -1 if missing
+  static uint64_t calls[PERF_NREGIONS];
+  static PerfSample totals[PERF_NREGIONS];
+  static bool uncounted[PERF_NREGIONS];   // some call of the region was timed only
+  static bool counted(int region, PerfEvent event);
+public:
+  static bool open();     // returns false when only timing is available
+  static void close();
+  static bool isEnabled();
+  static bool hasEvent(PerfEvent event);
+  static void sample(PerfSample *s);
+  static void account(PerfRegion region, const PerfSample &begin, const PerfSample &end);
+  static void report(ostream &out);
+};
+
+// Measures its own lifetime as one call of the region.
+class PerfScope {
+private:
+  PerfRegion region;
+  PerfSample begin;
+public:
+  PerfScope(PerfRegion region);
+  ~PerfScope();
+};
@@ -0,0 +1,181 @@
+#include <string.h>
+#include "Persistent.h"
+
+std::atomic<int> PersistentBoard::nRowAlloc(0);
+std::atomic<int> PersistentBoard::nRowFree(0);
+
+int PersistentBoard::get_nRowAlloc() { return nRowAlloc; }
+
+int PersistentBoard::get_nRowFree() { return nRowFree; }
+
+BoardRow *PersistentBoard::newRow(const int *cells) {
+  BoardRow *row = new BoardRow;
+  row->refs.store(1);
+  row->cells = new int[dx];
+  memcpy(row->cells, cells, dx * sizeof(int));
+  nRowAlloc++;
+  return row;
+}
+
+void PersistentBoard::retain(BoardRow *row) { row->refs.fetch_add(1, memory_order_relaxed); }
+
+void PersistentBoard::release(BoardRow *row) {
+  if (row->refs.fetch_sub(1, memory_order_acq_rel) == 1) {
+    delete[] row->cells;
+    delete row;
+    nRowFree++;
+  }
+}
+
+void PersistentBoard::releaseAll() {
+  if (rows == NULL) return;
+  for (int y = 0; y < dy; y++)
+    release(rows[y]);
+  delete[] rows;
+  rows = NULL;
+}
+
+PersistentBoard::PersistentBoard() {
+  dy = 0;
+  dx = 0;
+  rows = NULL;
+}
+
+PersistentBoard::PersistentBoard(const Matrix *obj) {
+  dy = obj->get_dy();
+  dx = obj->get_dx();
+  rows = (dy > 0) ? new BoardRow*[dy] : NULL;
+  int **array = obj->get_array();
+  for (int y = 0; y < dy; y++)
+    rows[y] = newRow(array[y]);
+}
+
+PersistentBoard::PersistentBoard(const PersistentBoard &obj) {
+  dy = obj.dy;
+  dx = obj.dx;
+  rows = (obj.rows != NULL) ? new BoardRow*[dy] : NULL;
+  for (int y = 0; (rows != NULL) && (y < dy); y++) {
+    rows[y] = obj.rows[y];
+    retain(rows[y]);
+  }
+}
+
+PersistentBoard::~PersistentBoard() { releaseAll(); }
+
+PersistentBoard& PersistentBoard::operator=(const PersistentBoard &obj) {
+  if (this == &obj) return *this;
+  // retain first: obj may share rows with this
+  BoardRow **table = (obj.rows != NULL) ? new BoardRow*[obj.dy] : NULL;
+  for (int y = 0; (table != NULL) && (y < obj.dy); y++) {
+    table[y] = obj.rows[y];
+    retain(table[y]);
+  }
+  releaseAll();
+  dy = obj.dy;
+  dx = obj.dx;
+  rows = table;
+  return *this;
+}
+
+int PersistentBoard::get_dy() const { return dy; }
+
+int PersistentBoard::get_dx() const { return dx; }
+
+int PersistentBoard::get(int y, int x) const { return rows[y]->cells[x]; }
+
+const int *PersistentBoard::row(int y) const { return rows[y]->cells; }
+
+bool PersistentBoard::sharesRow(const PersistentBoard &obj, int y) const {
+  return (y < dy) && (y < obj.dy) && (rows[y] == obj.rows[y]);
+}
+
+// iScreen = iScreen + blk at (top, left), as the lock in the game loop does
+PersistentBoard PersistentBoard::place(const Matrix *blk, int top, int left) const {
+  PersistentBoard temp(*this);
+  int **b_array = blk->get_array();
+  if ((top < 0) || (left < 0) || (top + blk->get_dy() > dy) || (left + blk->get_dx() > dx)) {
+    cerr << "invalid matrix range" << endl;
+    return temp;
+  }
+  for (int y = 0; y < blk->get_dy(); y++) {
+    bool touched = false;
+    for (int x = 0; x < blk->get_dx(); x++)
+      if (b_array[y][x] != 0)
+        touched = true;
+    if (!touched) continue;
+
+    BoardRow *row = temp.newRow(rows[top + y]->cells);
+    for (int x = 0; x < blk->get_dx(); x++)
+      row->cells[left + x] += b_array[y][x];
+    release(temp.rows[top + y]);
+    temp.rows[top + y] = row;
+  }
+  return temp;
+}
+
+// Same rows and shifting as deleteFullLines() in Tetris.cpp: rows top ..
+// top + blockHeight - 1 above floorRow are checked in order, rows above a
+// full one move down and the top row stays as it was.
+PersistentBoard PersistentBoard::deleteFullLines(int top, int blockHeight, int floorRow, int *nDeleted) const {
+  PersistentBoard temp(*this);
+  int n = 0;
+  for (int i = top; (i < top + blockHeight) && (i < floorRow) && (i < dy); i++) {
+    bool isFull = true;
+    for (int x = 0; x < dx; x++)
+      if (temp.rows[i]->cells[x] == 0)
+        isFull = false;
+    if (!isFull) continue;
+
+    n++;
+    if (i == 0) continue;   // counted, but nothing above it to move down
+    release(temp.rows[i]);
+    for (int y = i; y > 0; y--)
+      temp.rows[y] = temp.rows[y - 1];
+    retain(temp.rows[0]);   // now referenced from rows 0 and 1
+  }
+  if (nDeleted != NULL)
+    *nDeleted = n;
+  return temp;
+}
+
+void PersistentBoard::toMatrix(Matrix *obj) const {
+  if ((obj->get_dy() != dy) || (obj->get_dx() != dx)) {
+    cerr << "matrix size mismatch" << endl;
+    return;
+  }
+  int **array = obj->get_array();
+  for (int y = 0; y < dy; y++)
+    memcpy(array[y], rows[y]->cells, dx * sizeof(int));
+}
+
+/**************************************************************/
+/*********************** BoardHistory *************************/
+/**************************************************************/
+
+BoardHistory::BoardHistory() { cursor = -1; }
+
+void BoardHistory::commit(const BoardVersion &version) {
+  versions.resize(cursor + 1);
+  versions.push_back(version);
+  cursor++;
+}
+
+bool BoardHistory::undo(BoardVersion *version) {
+  if (cursor <= 0) return false;
+  cursor--;
+  *version = versions[cursor];
+  return true;
+}
+
+bool BoardHistory::redo(BoardVersion *version) {
+  if (cursor + 1 >= (int) versions.size()) return false;
+  cursor++;
+  *version = versions[cursor];
+  return true;
+}
+
+const BoardVersion &BoardHistory::current() const { return versions[cursor]; }
+
+bool BoardHistory::isEmpty() const { return cursor < 0; }
+
+int BoardHistory::size() const { return versions.size(); }
@@ -0,0 +1,70 @@
+#pragma once
+#include <atomic>
+#include <vector>
+#include "Matrix.h"
+
+// Copy-on-write board versions.
+// A board is a table of pointers to immutable, reference-counted rows.
+// place() and deleteFullLines() build a new version that shares every row
+// it did not change with its parent: placing a block copies only the rows
+// the block touches, and clearing lines copies no cells at all, it only
+// moves row pointers. Each version costs one row table plus its new rows,
+// so thousands of versions (undo history, search trees) stay cheap.
+
+struct BoardRow {
+  std::atomic<int> refs;
+  int *cells;
+};
+
+class PersistentBoard {
+private:
+  static std::atomic<int> nRowAlloc;
+  static std::atomic<int> nRowFree;
+  int dy;
+  int dx;
+  BoardRow **rows;
+  BoardRow *newRow(const int *cells);
+  static void retain(BoardRow *row);
+  static void release(BoardRow *row);
+  void releaseAll();
+public:
+  static int get_nRowAlloc();
+  static int get_nRowFree();
+  PersistentBoard();
+  PersistentBoard(const Matrix *obj);
+  PersistentBoard(const PersistentBoard &obj);
+  ~PersistentBoard();
+  PersistentBoard& operator=(const PersistentBoard &obj);
+  int get_dy() const;
+  int get_dx() const;
+  int get(int y, int x) const;
+  const int *row(int y) const;
+  bool sharesRow(const PersistentBoard &obj, int y) const;
+  PersistentBoard place(const Matrix *blk, int top, int left) const;
+  PersistentBoard deleteFullLines(int top, int blockHeight, int floorRow, int *nDeleted) const;
+  void toMatrix(Matrix *obj) const;
+};
+
+// Game state at the moment a new block appears, for undo and redo.
+struct BoardVersion {
+  PersistentBoard board;
+  int blockType;
+  int blockDegree;
+  int score;
+  int nBlocks;
+  unsigned int rngSeed;
+};
+
+class BoardHistory {
+private:
+  vector<BoardVersion> versions;
+  int cursor;
+public:
+  BoardHistory();
+  void commit(const BoardVersion &version);   // drops the redo branch
+  bool undo(BoardVersion *version);
+  bool redo(BoardVersion *version);
+  const BoardVersion &current() const;
+  bool isEmpty() const;
+  int size() const;
+};
@@ -0,0 +1,170 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "Matrix.h"
+#include "Tetris.h"
+#include "Bot.h"
+#include "Corpus.h"
+#include "Scheduler.h"
+
+using namespace std;
+
+// Builds position corpora from bot games, and runs placement queries over
+// them. Queries read the memory-mapped corpus window by window: the chunks
+// of a window are answered in parallel into per-chunk buffers, which are
+// then written out in corpus order while the next window is prefetched.
+// A window is a few chunks per worker, so memory use follows the number of
+// threads, whatever the corpus size.
+//
+// Output, one line per position:     index placements max_lines game_overs
+//          with -p, one per placement: index degree left landing lines game_over
+
+#define CHUNK_POSITIONS 1024
+#define WINDOW_CHUNKS_PER_THREAD 4
+
+// Every position where a new block appears, in bot games of consecutive seeds.
+int buildCorpus(const char *path, int nGames, int maxBlocks, unsigned int seed,
+                Matrix *setOfBlockObjects[MAX_BLK_TYPES][MAX_BLK_DEGREES]) {
+    CorpusWriter writer;
+    if (!writer.open(path))
+        return 1;
+    double weights[BOT_NFEATURES] = { 1.0, -0.5, -1.5, -0.3, -0.2 };
+    Bot bot(weights);
+
+    bool ok = true;
+    for (int g = 0; (g < nGames) && ok; g++) {
+        int recorded = 0;
+        int degree = 0;   // of the block before the last key
+        playGame(setOfBlockObjects, bot, seed + g, maxBlocks, NULL, [&](const Tetris &game) {
+            // a new block appears in step() before its key is handled, so it
+            // is recorded where it spawned: keeping the last block's degree
+            if (ok && (game.get_nBlocks() != recorded) && (game.get_nBlocks() <= maxBlocks)) {
+                ok = writer.append(game.get_iScreen(), game.get_blockType(), degree, INIT_TOP, INIT_LEFT);
+                recorded = game.get_nBlocks();
+            }
+            degree = game.get_idxBlockDegree();
+        });
+    }
+    if (!ok || !writer.close())
+        return 1;
+    cout << writer.get_nPositions() << " positions written to " << path << endl;
+    return 0;
+}
+
+int queryCorpus(const char *path, int nThreads, bool perPlacement, bool quiet,
+                Matrix *setOfBlockObjects[MAX_BLK_TYPES][MAX_BLK_DEGREES]) {
+    CorpusFile corpus;
+    if (!corpus.open(path))
+        return 1;
+    PlacementQuery query(setOfBlockObjects);
+    TaskScheduler scheduler(nThreads);
+    uint64_t nPositions = corpus.get_nPositions();
+    uint64_t nChunks = (nPositions + CHUNK_POSITIONS - 1) / CHUNK_POSITIONS;
+    uint64_t windowChunks = (uint64_t) WINDOW_CHUNKS_PER_THREAD * scheduler.get_nThreads();
+    vector<string> buffers(windowChunks);
+    vector<uint64_t> nPlacements(windowChunks);
+    uint64_t totalPlacements = 0;
+
+    auto begin = chrono::steady_clock::now();
+    corpus.prefetch(0, min(nPositions, windowChunks * CHUNK_POSITIONS));
+    for (uint64_t first = 0; first < nChunks; first += windowChunks) {
+        uint64_t last = min(nChunks, first + windowChunks);
+        corpus.prefetch(last * CHUNK_POSITIONS, min(nPositions, (last + windowChunks) * CHUNK_POSITIONS));
+        scheduler.parallelFor(first, last, 1, [&](long from, long to, int worker) {
+            Placement placements[MAX_PLACEMENTS];
+            char line[96];
+            for (long c = from; c < to; c++) {
+                string &out = buffers[c - first];
+                out.clear();
+                nPlacements[c - first] = 0;
+                uint64_t end = min(nPositions, (uint64_t) (c + 1) * CHUNK_POSITIONS);
+                for (uint64_t i = (uint64_t) c * CHUNK_POSITIONS; i < end; i++) {
+                    int n = query.placements(*corpus.get_position(i), placements);
+                    nPlacements[c - first] += n;
+                    if (quiet) continue;
+                    if (perPlacement) {
+                        for (int k = 0; k < n; k++) {
+                            const Placement &p = placements[k];
+                            int len = snprintf(line, sizeof(line), "%llu %d %d %d %d %d\n", (unsigned long long) i,
+                                               p.degree, p.left, p.landing, p.lines, p.gameOver);
+                            out.append(line, len);
+                        }
+                    } else {
+                        int maxLines = 0, nGameOver = 0;
+                        for (int k = 0; k < n; k++) {
+                            maxLines = max(maxLines, (int) placements[k].lines);
+                            nGameOver += placements[k].gameOver;
+                        }
+                        int len = snprintf(line, sizeof(line), "%llu %d %d %d\n", (unsigned long long) i,
+                                           n, maxLines, nGameOver);
+                        out.append(line, len);
+                    }
+                }
+            }
+        });
+        for (uint64_t c = first; c < last; c++) {
+            if (!buffers[c - first].empty() &&
+                (fwrite(buffers[c - first].data(), 1, buffers[c - first].size(), stdout) != buffers[c - first].size())) {
+                cerr << "cannot write results" << endl;
+                return 1;
+            }
+            totalPlacements += nPlacements[c - first];
+        }
+    }
+    fflush(stdout);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    cerr << nPositions << " positions, " << totalPlacements << " placements, "
+         << (uint64_t) (nPositions / seconds) << " positions/s on " << scheduler.get_nThreads() << " threads" << endl;
+    return 0;
+}
+
+void usage(const char *name) {
+    cerr << "usage: " << name << " -b corpus [-n games] [-m max_blocks] [-s seed]" << endl;
+    cerr << "       " << name << " [-j threads] [-p | -q] corpus" << endl;
+}
+
+int main(int argc, char *argv[]) {
+    const char *buildPath = NULL;
+    int nGames = 100;
+    int maxBlocks = 500;
+    unsigned int seed = 1;
+    int nThreads = 0;
+    bool perPlacement = false;
+    bool quiet = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "b:n:m:s:j:pq")) != -1) {
+        switch (opt) {
+            case 'b': buildPath = optarg; break;
+            case 'n': nGames = atoi(optarg); break;
+            case 'm': maxBlocks = atoi(optarg); break;
+            case 's': seed = strtoul(optarg, NULL, 10); break;
+            case 'j': nThreads = atoi(optarg); break;
+            case 'p': perPlacement = true; break;
+            case 'q': quiet = true; break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if ((buildPath == NULL) && (optind != argc - 1)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    Matrix *setOfBlockObjects[MAX_BLK_TYPES][MAX_BLK_DEGREES];
+    createBlockObjects(setOfBlockObjects);
+    int status;
+    if (buildPath != NULL)
+        status = buildCorpus(buildPath, nGames, maxBlocks, seed, setOfBlockObjects);
+    else
+        status = queryCorpus(argv[optind], nThreads, perPlacement, quiet, setOfBlockObjects);
+    deleteBlockObjects(setOfBlockObjects);
+    return status;
+}
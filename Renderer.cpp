@@ -0,0 +1,127 @@
+#include <chrono>
+#include <iostream>
+#include "Renderer.h"
+
+/**************************************************************/
+/*********************** TripleBuffer *************************/
+/**************************************************************/
+
+TripleBuffer::TripleBuffer(int cy, int cx) {
+  for (int i = 0; i < 3; i++)
+    frames[i] = new Matrix(cy, cx);
+  back = 0;
+  middle.store(1);
+  front = 2;
+  nPublished.store(0);
+  nDropped.store(0);
+}
+
+TripleBuffer::~TripleBuffer() {
+  for (int i = 0; i < 3; i++)
+    delete frames[i];
+}
+
+void TripleBuffer::publish(const Matrix *frame) {
+  *frames[back] = *frame;
+  int prev = middle.exchange(back | FRESH, std::memory_order_acq_rel);
+  if (prev & FRESH)
+    nDropped.fetch_add(1, std::memory_order_relaxed);
+  back = prev & ~FRESH;
+  nPublished.fetch_add(1, std::memory_order_relaxed);
+}
+
+Matrix *TripleBuffer::acquire() {
+  if (!(middle.load(std::memory_order_relaxed) & FRESH))
+    return NULL;
+  int prev = middle.exchange(front, std::memory_order_acq_rel);
+  front = prev & ~FRESH;
+  return frames[front];
+}
+
+unsigned long TripleBuffer::get_nPublished() const { return nPublished.load(); }
+
+unsigned long TripleBuffer::get_nDropped() const { return nDropped.load(); }
+
+/**************************************************************/
+/************************* Renderer ***************************/
+/**************************************************************/
+
+Renderer::Renderer() {
+  draw = NULL;
+  wallDepth = 0;
+  frames = NULL;
+  running.store(false);
+  nDrawn = 0;
+  nDropped = 0;
+}
+
+Renderer::~Renderer() { stop(); }
+
+bool Renderer::start(int cy, int cx, int wall_depth, void (*draw)(Matrix *screen, int wall_depth)) {
+  if (running.load()) return false;
+  this->draw = draw;
+  wallDepth = wall_depth;
+  frames = new TripleBuffer(cy, cx);
+  nDrawn = 0;
+  nDropped = 0;
+  running.store(true);
+  thread = std::thread(&Renderer::loop, this);
+  return true;
+}
+
+bool Renderer::isRunning() const { return running.load(); }
+
+void Renderer::loop() {
+  while (true) {
+    bool stopping = !running.load(std::memory_order_acquire);
+    Matrix *frame = frames->acquire();
+    if (frame != NULL) {
+      draw(frame, wallDepth);
+      nDrawn++;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!messages.empty()) {
+      std::string text;
+      text.swap(messages);
+      lock.unlock();
+      std::cout << text << std::flush;
+    }
+    else if (frame != NULL)
+      continue;
+    else if (stopping)
+      break;
+    else {
+      // the timeout covers a wakeup sent before we started waiting
+      wakeup.wait_for(lock, std::chrono::milliseconds(10));
+    }
+  }
+}
+
+void Renderer::submit(const Matrix *screen) {
+  frames->publish(screen);
+  wakeup.notify_one();
+}
+
+// The game thread may hold the tty in raw mode, so lines end in \r\n.
+void Renderer::print(const std::string &message) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    messages += message + "\r\n";
+  }
+  wakeup.notify_one();
+}
+
+// Draws the last submitted frame and pending messages, then joins the render thread.
+void Renderer::stop() {
+  if (!running.load()) return;
+  running.store(false, std::memory_order_release);
+  wakeup.notify_one();
+  thread.join();
+  nDropped = frames->get_nDropped();
+  delete frames;
+  frames = NULL;
+}
+
+unsigned long Renderer::get_nDrawn() const { return nDrawn; }
+
+unsigned long Renderer::get_nDropped() const { return (frames != NULL) ? frames->get_nDropped() : nDropped; }
@@ -0,0 +1,58 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "Matrix.h"
+
+// Lock-free triple buffer of frames.
+// The producer always owns a back frame and the consumer a front frame;
+// the third one sits in the middle and is swapped atomically by both sides.
+// publish() never waits, and a frame replaced before it was consumed counts
+// as dropped.
+class TripleBuffer {
+private:
+  static const int FRESH = 4;   // set on middle when it holds an unread frame
+  Matrix *frames[3];
+  std::atomic<int> middle;
+  int back;
+  int front;
+  std::atomic<unsigned long> nPublished;
+  std::atomic<unsigned long> nDropped;
+public:
+  TripleBuffer(int cy, int cx);
+  ~TripleBuffer();
+  void publish(const Matrix *frame);
+  Matrix *acquire();   // latest unread frame, or NULL if nothing new
+  unsigned long get_nPublished() const;
+  unsigned long get_nDropped() const;
+};
+
+// Draws frames on a dedicated thread so a slow terminal never stalls the game.
+// While it runs, the render thread owns the terminal: other threads hand it
+// their messages with print(), which it writes between frames.
+class Renderer {
+private:
+  void (*draw)(Matrix *screen, int wall_depth);
+  int wallDepth;
+  TripleBuffer *frames;
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable wakeup;
+  std::atomic<bool> running;
+  std::string messages;   // pending lines, guarded by mutex
+  unsigned long nDrawn;
+  unsigned long nDropped;
+  void loop();
+public:
+  Renderer();
+  ~Renderer();
+  bool start(int cy, int cx, int wall_depth, void (*draw)(Matrix *screen, int wall_depth));
+  bool isRunning() const;
+  void submit(const Matrix *screen);
+  void print(const std::string &message);
+  void stop();
+  unsigned long get_nDrawn() const;
+  unsigned long get_nDropped() const;
+};
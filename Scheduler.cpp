@@ -0,0 +1,94 @@
+#include "Scheduler.h"
+
+TaskScheduler::TaskScheduler(int nThreads) {
+  if (nThreads <= 0)
+    nThreads = thread::hardware_concurrency();
+  if (nThreads <= 0)
+    nThreads = 1;
+  this->nThreads = nThreads;
+  body = NULL;
+  nPending.store(0);
+  generation = 0;
+  quitting = false;
+  for (int i = 0; i < nThreads; i++)
+    queues.push_back(new WorkQueue);
+  for (int i = 0; i < nThreads; i++)
+    threads.push_back(std::thread(&TaskScheduler::workerLoop, this, i));
+}
+
+TaskScheduler::~TaskScheduler() {
+  {
+    lock_guard<std::mutex> guard(lock);
+    quitting = true;
+  }
+  wakeup.notify_all();
+  for (int i = 0; i < nThreads; i++)
+    threads[i].join();
+  for (int i = 0; i < nThreads; i++)
+    delete queues[i];
+}
+
+int TaskScheduler::get_nThreads() const { return nThreads; }
+
+bool TaskScheduler::popLocal(int id, Range *range) {
+  WorkQueue *q = queues[id];
+  lock_guard<std::mutex> guard(q->lock);
+  if (q->ranges.empty()) return false;
+  *range = q->ranges.back();
+  q->ranges.pop_back();
+  return true;
+}
+
+bool TaskScheduler::steal(int id, Range *range) {
+  for (int i = 1; i < nThreads; i++) {
+    WorkQueue *q = queues[(id + i) % nThreads];
+    lock_guard<std::mutex> guard(q->lock);
+    if (q->ranges.empty()) continue;
+    *range = q->ranges.front();
+    q->ranges.pop_front();
+    return true;
+  }
+  return false;
+}
+
+void TaskScheduler::workerLoop(int id) {
+  unsigned long seen = 0;
+  while (true) {
+    {
+      unique_lock<std::mutex> guard(lock);
+      wakeup.wait(guard, [&] { return quitting || (generation != seen); });
+      if (quitting) return;
+      seen = generation;
+    }
+    Range range;
+    while (popLocal(id, &range) || steal(id, &range)) {
+      (*body)(range.begin, range.end, id);
+      if (nPending.fetch_sub(1) == 1) {
+        lock_guard<std::mutex> guard(lock);
+        finished.notify_all();
+      }
+    }
+  }
+}
+
+void TaskScheduler::parallelFor(long begin, long end, long grain, const function<void(long, long, int)> &body) {
+  if (end <= begin) return;
+  if (grain <= 0) grain = 1;
+  lock_guard<std::mutex> call(callLock);
+
+  long nChunks = (end - begin + grain - 1) / grain;
+  this->body = &body;
+  nPending.store(nChunks);
+  for (long c = 0; c < nChunks; c++) {
+    Range range = { begin + c * grain, min(end, begin + (c + 1) * grain) };
+    WorkQueue *q = queues[c * nThreads / nChunks];
+    lock_guard<std::mutex> guard(q->lock);
+    q->ranges.push_back(range);
+  }
+
+  unique_lock<std::mutex> guard(lock);
+  generation++;
+  wakeup.notify_all();
+  finished.wait(guard, [&] { return nPending.load() == 0; });
+  this->body = NULL;
+}
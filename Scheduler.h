@@ -0,0 +1,48 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Work-stealing scheduler for data-parallel loops.
+// parallelFor() cuts [begin, end) into chunks of `grain` iterations and
+// deals contiguous runs of chunks to the workers' own deques. A worker takes
+// chunks from the back of its own deque and, once it runs dry, steals from
+// the front of the others', so uneven chunks (games of different length)
+// still keep every core busy.
+class TaskScheduler {
+private:
+  struct Range {
+    long begin;
+    long end;
+  };
+  struct WorkQueue {
+    std::mutex lock;
+    std::deque<Range> ranges;
+  };
+  int nThreads;
+  vector<std::thread> threads;
+  vector<WorkQueue *> queues;
+  const function<void(long, long, int)> *body;
+  std::atomic<long> nPending;
+  std::mutex lock;
+  std::condition_variable wakeup;
+  std::condition_variable finished;
+  std::mutex callLock;
+  unsigned long generation;
+  bool quitting;
+  bool popLocal(int id, Range *range);
+  bool steal(int id, Range *range);
+  void workerLoop(int id);
+public:
+  TaskScheduler(int nThreads);   // 0 uses every core
+  ~TaskScheduler();
+  int get_nThreads() const;
+  // body(begin, end, worker) runs once per chunk; returns when all chunks are done
+  void parallelFor(long begin, long end, long grain, const function<void(long, long, int)> &body);
+};
@@ -0,0 +1,270 @@
+#include <iostream>
+#include <iomanip>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include <vector>
+#include <unistd.h>
+
+#include "Matrix.h"
+#include "Tetris.h"
+#include "Bot.h"
+#include "Scheduler.h"
+#include "TileRenderer.h"
+
+using namespace std;
+
+// Self-play tuner for the bot weights.
+// Every generation samples a population of weight vectors around the current
+// mean, plays the same seeded games with each of them on all cores, and moves
+// the mean and spread towards the best quarter (cross-entropy method, a
+// diagonal cousin of CMA-ES). State is checkpointed after every generation.
+
+#define CHECKPOINT_VERSION 2
+
+struct TunerState {
+    // what the run was started with; a resume must use the same values
+    unsigned long long seed;
+    int population;
+    int nGames;
+    int generation;
+    unsigned long long rng;
+    double mean[BOT_NFEATURES];
+    double sigma[BOT_NFEATURES];
+    double bestFitness;
+    double best[BOT_NFEATURES];
+};
+
+unsigned long long nextRandom(unsigned long long *state) {
+    // xorshift64*
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ULL;
+}
+
+double nextGaussian(unsigned long long *state) {
+    double u1 = ((nextRandom(state) >> 11) + 0.5) / 9007199254740992.0;
+    double u2 = ((nextRandom(state) >> 11) + 0.5) / 9007199254740992.0;
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+// Game g of a generation gets the same seed for every candidate, so candidates
+// are compared on identical block sequences.
+unsigned int gameSeed(unsigned long long baseSeed, int generation, int game) {
+    unsigned long long h = baseSeed * 0x9E3779B97F4A7C15ULL + generation * 0xBF58476D1CE4E5B9ULL + game;
+    h ^= h >> 31;
+    h *= 0x94D049BB133111EBULL;
+    h ^= h >> 29;
+    return (unsigned int) h;
+}
+
+bool saveCheckpoint(const char *path, const TunerState &state) {
+    char tmpPath[4096];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+    FILE *fp = fopen(tmpPath, "w");
+    if (fp == NULL) {
+        cerr << "cannot open " << tmpPath << endl;
+        return false;
+    }
+    fprintf(fp, "selfplay %d\n", CHECKPOINT_VERSION);
+    fprintf(fp, "seed %llu\npopulation %d\ngames %d\n", state.seed, state.population, state.nGames);
+    fprintf(fp, "generation %d\nrng %llu\nbestFitness %.17g\n", state.generation, state.rng, state.bestFitness);
+    for (int i = 0; i < BOT_NFEATURES; i++)
+        fprintf(fp, "%s %.17g %.17g %.17g\n", botFeatureNames[i], state.mean[i], state.sigma[i], state.best[i]);
+    bool ok = (fclose(fp) == 0);
+    if (!ok || (rename(tmpPath, path) < 0)) {
+        cerr << "cannot write checkpoint " << path << endl;
+        return false;
+    }
+    return true;
+}
+
+bool loadCheckpoint(const char *path, TunerState *state) {
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+        return false;
+    int version = 0;
+    bool ok = (fscanf(fp, "selfplay %d\n", &version) == 1) && (version == CHECKPOINT_VERSION) &&
+              (fscanf(fp, "seed %llu\npopulation %d\ngames %d\n",
+                      &state->seed, &state->population, &state->nGames) == 3) &&
+              (fscanf(fp, "generation %d\nrng %llu\nbestFitness %lg\n",
+                      &state->generation, &state->rng, &state->bestFitness) == 3);
+    for (int i = 0; ok && (i < BOT_NFEATURES); i++) {
+        char name[64];
+        ok = (fscanf(fp, "%63s %lg %lg %lg\n", name, &state->mean[i], &state->sigma[i], &state->best[i]) == 4) &&
+             (strcmp(name, botFeatureNames[i]) == 0);
+    }
+    fclose(fp);
+    if (!ok)
+        cerr << "invalid checkpoint " << path << endl;
+    return ok;
+}
+
+void usage(const char *name) {
+    cerr << "usage: " << name << " [-j threads] [-g generations] [-p population] [-n games]"
+         << " [-m max_blocks] [-s seed] [-c checkpoint] [-w watched_games]" << endl;
+}
+
+int main(int argc, char *argv[]) {
+    int nThreads = 0;
+    int nGenerations = 20;
+    int population = 32;
+    int nGames = 8;
+    int maxBlocks = 200;
+    unsigned long long seed = 1;
+    const char *checkpointPath = NULL;
+    int nWatched = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "j:g:p:n:m:s:c:w:")) != -1) {
+        switch (opt) {
+            case 'j': nThreads = atoi(optarg); break;
+            case 'g': nGenerations = atoi(optarg); break;
+            case 'p': population = atoi(optarg); break;
+            case 'n': nGames = atoi(optarg); break;
+            case 'm': maxBlocks = atoi(optarg); break;
+            case 's': seed = strtoull(optarg, NULL, 10); break;
+            case 'c': checkpointPath = optarg; break;
+            case 'w': nWatched = atoi(optarg); break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if ((population < 4) || (nGames < 1) || (maxBlocks < 1)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    TunerState state;
+    state.seed = seed;
+    state.population = population;
+    state.nGames = nGames;
+    state.generation = 0;
+    state.rng = seed * 2 + 1;
+    state.bestFitness = -1;
+    for (int i = 0; i < BOT_NFEATURES; i++) {
+        state.mean[i] = 0;
+        state.sigma[i] = 1;
+        state.best[i] = 0;
+    }
+    if ((checkpointPath != NULL) && (access(checkpointPath, F_OK) == 0)) {
+        if (!loadCheckpoint(checkpointPath, &state))
+            return 1;
+        // other seeds or sizes would change the games and the meaning of mean/sigma
+        if ((state.seed != seed) || (state.population != population) || (state.nGames != nGames)) {
+            cerr << checkpointPath << " was started with -s " << state.seed << " -p " << state.population
+                 << " -n " << state.nGames << "; resume with the same options" << endl;
+            return 1;
+        }
+        cout << "resumed from " << checkpointPath << " at generation " << state.generation << endl;
+    }
+
+    Matrix *setOfBlockObjects[MAX_BLK_TYPES][MAX_BLK_DEGREES];
+    createBlockObjects(setOfBlockObjects);
+    TaskScheduler scheduler(nThreads);
+    int nElite = population / 4;
+
+    vector<double> candidates(population * BOT_NFEATURES);
+    vector<double> fitness(population);
+    vector<double> results(population * nGames);
+    vector<int> order(population);
+
+    // -w: the first games of every generation, live in a grid
+    TileRenderer watch;
+    nWatched = min(nWatched, population * nGames);
+    if (nWatched > 0)
+        watch.start(nWatched, ARRAY_DY, ARRAY_DX, SCREEN_DW, 0, cellSymbol);
+
+    for (; state.generation < nGenerations; state.generation++) {
+        for (int c = 0; c < population; c++)
+            for (int i = 0; i < BOT_NFEATURES; i++)
+                candidates[c * BOT_NFEATURES + i] = state.mean[i] + state.sigma[i] * nextGaussian(&state.rng);
+
+        auto begin = chrono::steady_clock::now();
+        int generation = state.generation;
+        scheduler.parallelFor(0, population * nGames, 1, [&](long from, long to, int worker) {
+            for (long k = from; k < to; k++) {
+                int c = k / nGames;
+                Bot bot(&candidates[c * BOT_NFEATURES]);
+                int nBlocks;
+                function<void(const Tetris &)> onStep = nullptr;
+                if (k < nWatched)
+                    onStep = [&watch, k](const Tetris &game) { watch.submit(k, game.get_oScreen()); };
+                int lines = playGame(setOfBlockObjects, bot, gameSeed(seed, generation, k % nGames),
+                                     maxBlocks, &nBlocks, onStep);
+                // lines first, surviving longer breaks ties
+                results[k] = lines + (double) nBlocks / (maxBlocks + 1);
+            }
+        });
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+        for (int c = 0; c < population; c++) {
+            fitness[c] = 0;
+            for (int g = 0; g < nGames; g++)
+                fitness[c] += results[c * nGames + g];
+            fitness[c] /= nGames;
+            order[c] = c;
+        }
+        sort(order.begin(), order.end(), [&](int a, int b) { return fitness[a] > fitness[b]; });
+
+        if (fitness[order[0]] > state.bestFitness) {
+            state.bestFitness = fitness[order[0]];
+            for (int i = 0; i < BOT_NFEATURES; i++)
+                state.best[i] = candidates[order[0] * BOT_NFEATURES + i];
+        }
+        double meanFitness = 0;
+        for (int c = 0; c < population; c++)
+            meanFitness += fitness[c] / population;
+
+        for (int i = 0; i < BOT_NFEATURES; i++) {
+            double m = 0, v = 0;
+            for (int e = 0; e < nElite; e++)
+                m += candidates[order[e] * BOT_NFEATURES + i] / nElite;
+            for (int e = 0; e < nElite; e++) {
+                double d = candidates[order[e] * BOT_NFEATURES + i] - m;
+                v += d * d / nElite;
+            }
+            state.mean[i] = m;
+            state.sigma[i] = sqrt(v) + 0.01;   // keep exploring a little
+        }
+
+        double gamesPerSec = population * nGames / seconds;
+        ostringstream line;
+        line << "gen " << state.generation
+             << fixed << setprecision(3)
+             << " best " << fitness[order[0]] << " mean " << meanFitness
+             << setprecision(1)
+             << " games/s " << gamesPerSec << " games/s/core " << gamesPerSec / scheduler.get_nThreads();
+        if (watch.isRunning())
+            watch.setStatus(line.str());
+        else
+            cout << line.str() << endl;
+
+        if (checkpointPath != NULL) {
+            TunerState next = state;
+            next.generation++;
+            if (!saveCheckpoint(checkpointPath, next))
+                return 1;
+        }
+    }
+
+    if (watch.isRunning()) {
+        watch.stop();
+        cout << "(refreshes, bytes, dropped frames) = (" << watch.get_nRefreshes() << "," << watch.get_nBytes()
+             << "," << watch.get_nDropped() << ")" << endl;
+    }
+
+    cout << fixed << setprecision(1) << "best fitness " << state.bestFitness << endl;
+    cout << setprecision(4);
+    for (int i = 0; i < BOT_NFEATURES; i++)
+        cout << botFeatureNames[i] << " " << state.best[i] << endl;
+
+    deleteBlockObjects(setOfBlockObjects);
+    return 0;
+}
@@ -0,0 +1,135 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Snapshot.h"
+
+int snapshotWords(int dy, int dx) { return (dy * dx + 63) / 64; }
+
+bool saveSnapshot(const char *path, const SnapshotHeader &state, const Matrix *screen) {
+  int dy = screen->get_dy();
+  int dx = screen->get_dx();
+  int **array = screen->get_array();
+  int nWords = snapshotWords(dy, dx);
+
+  SnapshotHeader header = state;
+  header.magic = SNAPSHOT_MAGIC;
+  header.version = SNAPSHOT_VERSION;
+  header.headerSize = sizeof(SnapshotHeader);
+  header.dy = dy;
+  header.dx = dx;
+
+  uint64_t *bits = new uint64_t[2 * nWords];
+  uint64_t *over = bits + nWords;
+  memset(bits, 0, 2 * nWords * sizeof(uint64_t));
+  for (int y = 0; y < dy; y++)
+    for (int x = 0; x < dx; x++) {
+      int i = y * dx + x;
+      bits[i >> 6] |= (uint64_t) (array[y][x] != 0) << (i & 63);
+      over[i >> 6] |= (uint64_t) (array[y][x] >= 2) << (i & 63);
+    }
+
+  // write a temporary file and rename it, so a crash never leaves half a snapshot
+  char tmpPath[4096];
+  snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+  FILE *fp = fopen(tmpPath, "wb");
+  if (fp == NULL) {
+    cerr << "cannot open " << tmpPath << ": " << strerror(errno) << endl;
+    delete[] bits;
+    return false;
+  }
+  bool ok = (fwrite(&header, sizeof(header), 1, fp) == 1) &&
+            (fwrite(bits, sizeof(uint64_t), 2 * nWords, fp) == (size_t) (2 * nWords));
+  ok = (fclose(fp) == 0) && ok;
+  delete[] bits;
+  if (!ok || (rename(tmpPath, path) < 0)) {
+    cerr << "cannot write snapshot " << path << endl;
+    unlink(tmpPath);
+    return false;
+  }
+  return true;
+}
+
+SnapshotFile::SnapshotFile() {
+  addr = NULL;
+  length = 0;
+  header = NULL;
+  bits = NULL;
+  over = NULL;
+}
+
+SnapshotFile::~SnapshotFile() { close(); }
+
+bool SnapshotFile::open(const char *path) {
+  close();
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0) {
+    cerr << "cannot open " << path << ": " << strerror(errno) << endl;
+    return false;
+  }
+  struct stat st;
+  if ((fstat(fd, &st) < 0) || ((size_t) st.st_size < sizeof(SnapshotHeader))) {
+    cerr << "invalid snapshot " << path << endl;
+    ::close(fd);
+    return false;
+  }
+  length = st.st_size;
+  addr = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (addr == MAP_FAILED) {
+    cerr << "mmap error: " << strerror(errno) << endl;
+    addr = NULL;
+    return false;
+  }
+
+  header = (const SnapshotHeader *) addr;
+  int nPlanes = (header->version == 1) ? 1 : 2;
+  int nWords = snapshotWords(header->dy, header->dx);
+  if ((header->magic != SNAPSHOT_MAGIC) || (header->version < 1) || (header->version > SNAPSHOT_VERSION) ||
+      (header->headerSize != sizeof(SnapshotHeader)) ||
+      (length < sizeof(SnapshotHeader) + nPlanes * nWords * sizeof(uint64_t))) {
+    cerr << "invalid snapshot " << path << endl;
+    close();
+    return false;
+  }
+  bits = (const uint64_t *) ((const char *) addr + header->headerSize);
+  over = (nPlanes == 2) ? bits + nWords : NULL;
+  return true;
+}
+
+void SnapshotFile::close() {
+  if (addr != NULL)
+    munmap(addr, length);
+  addr = NULL;
+  length = 0;
+  header = NULL;
+  bits = NULL;
+  over = NULL;
+}
+
+const SnapshotHeader *SnapshotFile::get_header() const { return header; }
+
+int SnapshotFile::cell(int y, int x) const {
+  int i = y * header->dx + x;
+  int value = (bits[i >> 6] >> (i & 63)) & 1;
+  if (over != NULL)
+    value += (over[i >> 6] >> (i & 63)) & 1;
+  return value;
+}
+
+bool SnapshotFile::restore(Matrix *screen) const {
+  if (header == NULL) return false;
+  if ((screen->get_dy() != header->dy) || (screen->get_dx() != header->dx)) {
+    cerr << "snapshot size does not match the screen" << endl;
+    return false;
+  }
+  int **array = screen->get_array();
+  for (int y = 0; y < header->dy; y++)
+    for (int x = 0; x < header->dx; x++)
+      array[y][x] = cell(y, x);
+  return true;
+}
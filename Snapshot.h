@@ -0,0 +1,54 @@
+#pragma once
+#include <stdint.h>
+#include "Matrix.h"
+
+// Binary game snapshot, version 2 (native little-endian):
+//   SnapshotHeader (32 bytes)
+//   ceil(dy*dx / 64) uint64_t words, one bit per iScreen cell, row-major: cell != 0
+//   the same number of words again:                                      cell >= 2
+// The rules tell three values apart (empty, filled, and 2+ where a block
+// was merged onto another), so a cell is restored as 0, 1 or 2. Version 1
+// files hold the first plane only and are still read.
+// The header is laid out so that a memory-mapped file can be read in place.
+
+#define SNAPSHOT_MAGIC 0x504e5354  // "TSNP"
+#define SNAPSHOT_VERSION 2
+
+struct SnapshotHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t headerSize;
+  uint16_t dy;
+  uint16_t dx;
+  uint8_t blockType;
+  uint8_t blockDegree;
+  uint8_t pendingLock;   // the current block has landed but is not merged yet
+  uint8_t reserved0;
+  int16_t top;
+  int16_t left;
+  uint32_t rngSeed;
+  uint32_t score;
+  uint32_t reserved1;
+};
+
+static_assert(sizeof(SnapshotHeader) == 32, "snapshot header must stay 32 bytes");
+
+int snapshotWords(int dy, int dx);
+bool saveSnapshot(const char *path, const SnapshotHeader &state, const Matrix *screen);
+
+class SnapshotFile {
+private:
+  void *addr;
+  size_t length;
+  const SnapshotHeader *header;
+  const uint64_t *bits;
+  const uint64_t *over;   // NULL for version 1
+public:
+  SnapshotFile();
+  ~SnapshotFile();
+  bool open(const char *path);
+  void close();
+  const SnapshotHeader *get_header() const;
+  int cell(int y, int x) const;   // 0, 1 or 2 (2 or more)
+  bool restore(Matrix *screen) const;
+};
@@ -0,0 +1,108 @@
+#include "SparsePiece.h"
+
+SparsePiece::SparsePiece() {
+  nCells = 0;
+  dy = 0;
+  dx = 0;
+}
+
+SparsePiece::SparsePiece(const Matrix *blk) {
+  nCells = 0;
+  set(blk);
+}
+
+SparsePiece::SparsePiece(const PieceCell *cells, int nCells) {
+  this->nCells = 0;
+  set(cells, nCells);
+}
+
+bool SparsePiece::set(const Matrix *blk) {
+  PieceCell temp[MAX_PIECE_CELLS];
+  int n = 0;
+  int **array = blk->get_array();
+  for (int y = 0; y < blk->get_dy(); y++)
+    for (int x = 0; x < blk->get_dx(); x++) {
+      if (array[y][x] == 0) continue;
+      if (n == MAX_PIECE_CELLS) {
+        cerr << "too many cells in piece" << endl;
+        return false;
+      }
+      temp[n].dy = y;
+      temp[n].dx = x;
+      n++;
+    }
+  if (!set(temp, n))
+    return false;
+  // the box of the matrix, empty rows and columns included
+  dy = blk->get_dy();
+  dx = blk->get_dx();
+  return true;
+}
+
+bool SparsePiece::set(const PieceCell *cells, int nCells) {
+  if ((nCells < 0) || (nCells > MAX_PIECE_CELLS)) {
+    cerr << "too many cells in piece" << endl;
+    return false;
+  }
+  this->nCells = nCells;
+  dy = 0;
+  dx = 0;
+  for (int i = 0; i < nCells; i++) {
+    this->cells[i] = cells[i];
+    if (cells[i].dy + 1 > dy) dy = cells[i].dy + 1;
+    if (cells[i].dx + 1 > dx) dx = cells[i].dx + 1;
+  }
+  return true;
+}
+
+int SparsePiece::get_nCells() const { return nCells; }
+
+int SparsePiece::get_dy() const { return dy; }
+
+int SparsePiece::get_dx() const { return dx; }
+
+const PieceCell *SparsePiece::get_cells() const { return cells; }
+
+bool SparsePiece::collides(const Matrix *screen, int top, int left) const {
+  int **array = screen->get_array();
+  int sy = screen->get_dy();
+  int sx = screen->get_dx();
+  for (int i = 0; i < nCells; i++) {
+    int y = top + cells[i].dy;
+    int x = left + cells[i].dx;
+    if ((y < 0) || (x < 0) || (y >= sy) || (x >= sx) || (array[y][x] != 0))
+      return true;
+  }
+  return false;
+}
+
+int SparsePiece::dropTop(const Matrix *screen, int top, int left) const {
+  while (!collides(screen, top + 1, left))
+    top++;
+  return top;
+}
+
+void SparsePiece::compose(Matrix *screen, int top, int left) const {
+  int **array = screen->get_array();
+  for (int i = 0; i < nCells; i++) {
+    int y = top + cells[i].dy;
+    int x = left + cells[i].dx;
+    if ((y < 0) || (x < 0) || (y >= screen->get_dy()) || (x >= screen->get_dx())) {
+      cerr << "invalid matrix range" << endl;
+      continue;
+    }
+    array[y][x] += 1;
+  }
+}
+
+int SparsePiece::lock(Matrix *screen, int top, int left) const {
+  compose(screen, top, left);
+  return deleteFullLines(screen, top, left, dy);
+}
+
+void createSparsePieces(Matrix *setOfBlockObjects[MAX_BLK_TYPES][MAX_BLK_DEGREES],
+                        SparsePiece pieces[MAX_BLK_TYPES][MAX_BLK_DEGREES]) {
+  for (int t = 0; t < MAX_BLK_TYPES; t++)
+    for (int d = 0; d < MAX_BLK_DEGREES; d++)
+      pieces[t][d].set(setOfBlockObjects[t][d]);
+}
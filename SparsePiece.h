@@ -0,0 +1,52 @@
+#pragma once
+#include <stdint.h>
+#include "Matrix.h"
+#include "Tetris.h"
+
+// A piece as the list of its occupied cells.
+// The dense block matrices are mostly empty (4 cells out of 9 or 16), yet
+// add() and anyGreaterThan() visit the whole bounding box. A SparsePiece
+// keeps the (dy, dx) offsets of the occupied cells, in row-major order, so
+// collision tests and placement touch only those cells on the board, and
+// larger polyominoes cost what their cell count costs.
+//
+// The bounding box is kept too: deleteFullLines() checks the rows it
+// spans, exactly as for the dense block.
+//
+// collides() differs from the dense test on one point. A board cell of 2 or
+// more (two blocks merged on top of each other) makes the dense test fail
+// anywhere in the bounding box, even under an empty block cell. Callers that
+// must match the game exactly use the dense test while such cells exist
+// (see Bot::choose).
+
+#define MAX_PIECE_CELLS 16
+
+struct PieceCell {
+  int8_t dy;
+  int8_t dx;
+};
+
+class SparsePiece {
+private:
+  int nCells;
+  int dy;
+  int dx;
+  PieceCell cells[MAX_PIECE_CELLS];
+public:
+  SparsePiece();
+  SparsePiece(const Matrix *blk);
+  SparsePiece(const PieceCell *cells, int nCells);
+  bool set(const Matrix *blk);
+  bool set(const PieceCell *cells, int nCells);
+  int get_nCells() const;
+  int get_dy() const;
+  int get_dx() const;
+  const PieceCell *get_cells() const;
+  bool collides(const Matrix *screen, int top, int left) const;  // a cell on a filled or missing one
+  int dropTop(const Matrix *screen, int top, int left) const;    // lowest top reached by falling
+  void compose(Matrix *screen, int top, int left) const;         // screen += piece
+  int lock(Matrix *screen, int top, int left) const;             // compose + deleteFullLines
+};
+
+void createSparsePieces(Matrix *setOfBlockObjects[MAX_BLK_TYPES][MAX_BLK_DEGREES],
+                        SparsePiece pieces[MAX_BLK_TYPES][MAX_BLK_DEGREES]);
@@ -0,0 +1,30 @@
+#include <iostream>
+#include <unistd.h>
+
+#include "Matrix.h"
+#include "Tetris.h"
+#include "Broadcast.h"
+
+using namespace std;
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    cerr << "usage: " << argv[0] << " <broadcast name>" << endl;
+    return 1;
+  }
+
+  Spectator spectator;
+  if (!spectator.attach(argv[1]))
+    return 1;
+
+  // the game owns all the work; each spectator only reads and renders
+  while (!spectator.isClosed()) {
+    if (spectator.poll() > 0) {
+      drawScreen(spectator.get_screen(), spectator.get_wallDepth());
+      cout << endl;
+    }
+    usleep(20000);
+  }
+  cout << "broadcast ended" << endl;
+  return 0;
+}
@@ -0,0 +1,540 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <math.h>
+
+#include "Matrix.h"
+#include "MatrixExpr.h"
+#include "Snapshot.h"
+#include "Perf.h"
+#include "Trace.h"
+#include "Tetris.h"
+
+using namespace std;
+
+/**************************************************************/
+/**************** Tetris Blocks Definitions *******************/
+/**************************************************************/
+int T0D0[] = {1, 1, 1, 1, -1};
+int T0D1[] = {1, 1, 1, 1, -1};
+int T0D2[] = {1, 1, 1, 1, -1};
+int T0D3[] = {1, 1, 1, 1, -1};
+
+int T1D0[] = {0, 1, 0, 1, 1, 1, 0, 0, 0, -1};
+int T1D1[] = {0, 1, 0, 0, 1, 1, 0, 1, 0, -1};
+int T1D2[] = {0, 0, 0, 1, 1, 1, 0, 1, 0, -1};
+int T1D3[] = {0, 1, 0, 1, 1, 0, 0, 1, 0, -1};
+
+int T2D0[] = {1, 0, 0, 1, 1, 1, 0, 0, 0, -1};
+int T2D1[] = {0, 1, 1, 0, 1, 0, 0, 1, 0, -1};
+int T2D2[] = {0, 0, 0, 1, 1, 1, 0, 0, 1, -1};
+int T2D3[] = {0, 1, 0, 0, 1, 0, 1, 1, 0, -1};
+
+int T3D0[] = {0, 0, 1, 1, 1, 1, 0, 0, 0, -1};
+int T3D1[] = {0, 1, 0, 0, 1, 0, 0, 1, 1, -1};
+int T3D2[] = {0, 0, 0, 1, 1, 1, 1, 0, 0, -1};
+int T3D3[] = {1, 1, 0, 0, 1, 0, 0, 1, 0, -1};
+
+int T4D0[] = {0, 1, 0, 1, 1, 0, 1, 0, 0, -1};
+int T4D1[] = {1, 1, 0, 0, 1, 1, 0, 0, 0, -1};
+int T4D2[] = {0, 1, 0, 1, 1, 0, 1, 0, 0, -1};
+int T4D3[] = {1, 1, 0, 0, 1, 1, 0, 0, 0, -1};
+
+int T5D0[] = {0, 1, 0, 0, 1, 1, 0, 0, 1, -1};
+int T5D1[] = {0, 0, 0, 0, 1, 1, 1, 1, 0, -1};
+int T5D2[] = {0, 1, 0, 0, 1, 1, 0, 0, 1, -1};
+int T5D3[] = {0, 0, 0, 0, 1, 1, 1, 1, 0, -1};
+
+int T6D0[] = {0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, -1};
+int T6D1[] = {0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, -1};
+int T6D2[] = {0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, -1};
+int T6D3[] = {0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, -1};
+
+int *setOfBlockArrays[] = {
+        T0D0, T0D1, T0D2, T0D3,
+        T1D0, T1D1, T1D2, T1D3,
+        T2D0, T2D1, T2D2, T2D3,
+        T3D0, T3D1, T3D2, T3D3,
+        T4D0, T4D1, T4D2, T4D3,
+        T5D0, T5D1, T5D2, T5D3,
+        T6D0, T6D1, T6D2, T6D3,
+};
+
+void createBlockObjects(Matrix *setOfBlockObjects[MAX_BLK_TYPES][MAX_BLK_DEGREES]) {
+    for (int i = 0; i < MAX_BLK_TYPES; i++) {
+        for (int j = 0; j < MAX_BLK_DEGREES; j++) {
+            int sideLength = getSideLength(setOfBlockArrays[i * MAX_BLK_DEGREES + j]);
+            setOfBlockObjects[i][j] = new Matrix(setOfBlockArrays[i * MAX_BLK_DEGREES + j], sideLength, sideLength);
+        }
+    }
+}
+
+// 기본 모양 하나에서 시계 방향으로 돌려 나머지 방향을 만듬 ('p' = 시계 방향)
+void deriveRotations(Matrix *base, Matrix *rotations[MAX_BLK_DEGREES]) {
+    rotations[0] = base;
+    for (int j = 1; j < MAX_BLK_DEGREES; j++)
+        rotations[j] = rotations[j - 1]->rotate90();
+}
+
+// Block set file: MAX_BLK_TYPES blocks in their first orientation, drawn with
+// '#' (filled) and '.' (empty), separated by blank lines; ';' starts a
+// comment line. Each block is padded to a square and turned to make the
+// other orientations. The classic set stays hand-typed: its S, Z and I
+// blocks are not pure rotations of one shape.
+bool loadBlockObjects(const char *path, Matrix *setOfBlockObjects[MAX_BLK_TYPES][MAX_BLK_DEGREES]) {
+    ifstream in(path);
+    if (!in) {
+        cerr << "cannot open " << path << endl;
+        return false;
+    }
+    vector<vector<string> > shapes(1);
+    string line;
+    while (getline(in, line)) {
+        if (!line.empty() && (line[line.size() - 1] == '\r'))
+            line.erase(line.size() - 1);
+        if (!line.empty() && (line[0] == ';'))
+            continue;
+        if (line.empty()) {
+            if (!shapes.back().empty())
+                shapes.push_back(vector<string>());
+            continue;
+        }
+        if (line.find_first_not_of("#.") != string::npos) {
+            cerr << "invalid block line in " << path << ": " << line << endl;
+            return false;
+        }
+        shapes.back().push_back(line);
+    }
+    if (shapes.back().empty())
+        shapes.pop_back();
+    if (shapes.size() != MAX_BLK_TYPES) {
+        cerr << path << " has " << shapes.size() << " blocks, " << MAX_BLK_TYPES << " needed" << endl;
+        return false;
+    }
+
+    for (int i = 0; i < MAX_BLK_TYPES; i++) {
+        int side = shapes[i].size();
+        for (size_t y = 0; y < shapes[i].size(); y++)
+            side = max(side, (int) shapes[i][y].size());
+        // the empty part of the box must fit in the walls and the floor
+        if (side > SCREEN_DW) {
+            cerr << "block " << i << " in " << path << " is larger than " << SCREEN_DW << "x" << SCREEN_DW << endl;
+            for (int k = 0; k < i; k++)
+                for (int j = 0; j < MAX_BLK_DEGREES; j++)
+                    delete setOfBlockObjects[k][j];
+            return false;
+        }
+        Matrix *base = new Matrix(side, side);
+        int **array = base->get_array();
+        for (size_t y = 0; y < shapes[i].size(); y++)
+            for (size_t x = 0; x < shapes[i][y].size(); x++)
+                array[y][x] = (shapes[i][y][x] == '#') ? 1 : 0;
+        deriveRotations(base, setOfBlockObjects[i]);
+    }
+    return true;
+}
+
+void deleteBlockObjects(Matrix *setOfBlockObjects[MAX_BLK_TYPES][MAX_BLK_DEGREES]) {
+    for (int i = 0; i < MAX_BLK_TYPES; i++) {
+        for (int j = 0; j < MAX_BLK_DEGREES; j++) {
+            delete setOfBlockObjects[i][j];
+        }
+    }
+}
+
+/**************************************************************/
+/******************** Tetris Game Rules ***********************/
+/**************************************************************/
+
+int arrayScreen[ARRAY_DY][ARRAY_DX] = {
+        {1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1},
+        {1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1},
+        {1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1},
+        {1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1},
+        {1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1},
+        {1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1},
+        {1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1},
+        {1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1},
+        {1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1},
+        {1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1},
+        {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
+        {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
+        {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
+        {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
+};
+
+int deleteFullLines(Matrix *gameMap, int top, int left, int blockHeight) {
+    PerfScope perf(PERF_DELETE_LINES);
+    TraceSpan span("deleteFullLines");
+//    gameMap->print();
+//    cout << "top : " << top << endl;
+//    cout << "left : " << left << endl;
+//    cout << "blockHeight : " << blockHeight << endl;
+
+    int **arrayGameMap = gameMap->get_array();
+    int nDeleted = 0;
+
+//    cout << "탐색해야 하는 위로부터의 거리" << endl;
+    for (int i = top; i < top + blockHeight; ++i) {
+        if (i > SCREEN_DY - 1) {
+            break;
+        }
+//        cout << i << endl;
+
+        bool isFull = true;
+        for (int j = 0; j < ARRAY_DX; ++j) {
+//            cout << arrayGameMap[i][j] << " ";
+            if (arrayGameMap[i][j] == 0) {
+                isFull = false;
+            }
+        }
+//        cout << endl << "isFull? " << isFull << endl;
+        if (isFull) {
+            gameMap->paste(gameMap->view(0, 0, i, ARRAY_DX), 1, 0);
+            nDeleted++;
+//            gameMap->print();
+        }
+    }
+    return nDeleted;
+}
+
+bool checkIsTouchedTop(Matrix *gameMap) {
+    TraceSpan span("checkIsTouchedTop");
+    int **arrayGameMap = gameMap->get_array();
+
+    bool isTopOccupied = false;
+    for (int i = SCREEN_DW; i < SCREEN_DX + SCREEN_DW; ++i) {
+//        cout << arrayGameMap[0][i] << " ";
+        if (arrayGameMap[0][i] == 1) {
+            isTopOccupied = true;
+            break;
+        }
+    }
+//    cout << endl;
+    if (isTopOccupied) {
+        return true;
+    }
+    else {
+        return false;
+    }
+}
+
+int getSideLength(int arr[]) {
+    int i = 0;
+    int counter = 0;
+    while (arr[i] != -1) {
+        counter++;
+        i++;
+    }
+    return sqrt(counter);
+}
+
+// 임시 백그라운드에 블럭을 더해서 addedBlk를 만들고, 충돌 여부를 돌려줌
+bool probeBlock(Matrix *screen, Matrix *blk, int top, int left, Matrix **addedBlk) {
+    PerfScope perf(PERF_COLLISION);
+    TraceSpan span("collision probe");
+    delete *addedBlk;
+    *addedBlk = screen->view(top, left, top + blk->get_dy(), left + blk->get_dx()).add(blk);
+    return (*addedBlk)->anyGreaterThan(1);
+}
+
+// addedBlk를 만들지 않고 충돌 여부만 확인
+bool collides(Matrix *screen, Matrix *blk, int top, int left) {
+    PerfScope perf(PERF_COLLISION);
+    TraceSpan span("collision probe");
+    return any(lazy(screen->view(top, left, top + blk->get_dy(), left + blk->get_dx())) + lazy(*blk) > 1);
+}
+
+/**************************************************************/
+/******************** Tetris Screen Drawing *******************/
+/**************************************************************/
+
+const char *cellSymbol(int value) {
+    if (value == 0)
+        return "□ ";
+    else if (value == 1)
+        return "■ ";
+    else if (value == 10)
+        return "◈ ";
+    else if (value == 20)
+        return "★ ";
+    else if (value == 30)
+        return "● ";
+    else if (value == 40)
+        return "◆ ";
+    else if (value == 50)
+        return "▲ ";
+    else if (value == 60)
+        return "♣ ";
+    else if (value == 70)
+        return "♥ ";
+    else
+        return "X ";
+}
+
+void drawScreen(Matrix *screen, int wall_depth) {
+    int dy = screen->get_dy();
+    int dx = screen->get_dx();
+    int dw = wall_depth;
+    int **array = screen->get_array();
+
+    for (int y = 0; y < dy - dw + 1; y++) {
+        for (int x = dw - 1; x < dx - dw + 1; x++)
+            cout << cellSymbol(array[y][x]);
+        cout << endl;
+    }
+}
+
+/**************************************************************/
+/*********************** Tetris Game **************************/
+/**************************************************************/
+
+Tetris::Tetris(Matrix *setOfBlockObjects[MAX_BLK_TYPES][MAX_BLK_DEGREES], unsigned int seed, bool verbose) {
+    this->setOfBlockObjects = setOfBlockObjects;
+    this->verbose = verbose;
+    // rand_r keeps the whole generator state in rngSeed, so snapshots can carry it
+    rngSeed = seed;
+    top = INIT_TOP;
+    left = INIT_LEFT;
+    idxBlockDegree = 0;
+    newBlockNeeded = false;
+    gameOver = false;
+    score = 0;
+    nBlocks = 1;
+
+    iScreen = new Matrix((int *) arrayScreen, ARRAY_DY, ARRAY_DX);
+    blockType = rand_r(&rngSeed) % MAX_BLK_TYPES;
+    currBlk = setOfBlockObjects[blockType][idxBlockDegree];
+    addedBlk = NULL;
+    oScreen = NULL;
+    probeBlock(iScreen, currBlk, top, left, &addedBlk);
+    compose();
+}
+
+Tetris::~Tetris() {
+    delete iScreen;
+    delete addedBlk;
+    delete oScreen;
+}
+
+// 화면 그려주기용 oScreen = iScreen + addedBlk
+void Tetris::compose() {
+    delete oScreen;
+    oScreen = new Matrix(iScreen);
+    oScreen->paste(addedBlk, top, left);
+}
+
+// 새로운 블록이 필요하다면, 쌓고 줄을 지운 뒤 새 블럭을 꺼냄. 게임 오버면 false
+bool Tetris::lockBlock() {
+    if (gameOver)
+        return false;
+    if (!newBlockNeeded)
+        return true;
+
+    delete iScreen;
+    iScreen = new Matrix(oScreen);
+
+    score += deleteFullLines(iScreen, top, left, currBlk->get_dy());
+    if (checkIsTouchedTop(iScreen)) {
+        gameOver = true;
+        return false;
+    }
+
+    top = INIT_TOP;
+    left = INIT_LEFT;
+
+    blockType = rand_r(&rngSeed) % MAX_BLK_TYPES;
+    currBlk = setOfBlockObjects[blockType][idxBlockDegree];
+    nBlocks++;
+
+    newBlockNeeded = false;
+    return true;
+}
+
+void Tetris::handleKey(char key) {
+    // 입력 처리
+    TraceSpan dispatch("key dispatch");
+    switch (key) {
+        case 'a':
+            left--;
+            break;
+        case 'd':
+            left++;
+            break;
+        case 's':
+            top++;
+            break;
+        case 'w':
+            break;
+        case 'p':
+            idxBlockDegree++;
+            if (idxBlockDegree > MAX_BLK_DEGREES - 1) {
+                idxBlockDegree = 0;
+            }
+            currBlk = setOfBlockObjects[blockType][idxBlockDegree];
+            break;
+        case 'l':
+            idxBlockDegree--;
+            if (idxBlockDegree < 0) {
+                idxBlockDegree = MAX_BLK_DEGREES - 1;
+            }
+            currBlk = setOfBlockObjects[blockType][idxBlockDegree];
+            break;
+        case ' ':
+            do {
+                // 내려감
+                top++;
+
+                // 임시 백그라운드와 현재 블럭의 합을 만들지 않고 바로 충돌체크
+            } while (!collides(iScreen, currBlk, top, left));
+            break;
+        default:
+            if (verbose)
+                cout << "wrong key input" << endl;
+    }
+    dispatch.end();
+
+    // 임시 백그라운드에 현재 블럭을 더해서 addedBlk를 만듬, 허락보다 용서가 쉽다
+    // 충돌처리, 이전으로 돌리고, 사후처리
+    if (probeBlock(iScreen, currBlk, top, left, &addedBlk)) {
+        TraceSpan rollback("rollback");
+        if (verbose) {
+            cout << "충돌발생!!!" << endl;
+            cout << "top : " << top << endl;
+            cout << "left : " << left << endl;
+        }
+
+        switch (key) {
+            case 'a':
+                left++;
+                break;
+            case 'd':
+                left--;
+                break;
+            case 's':
+                top--;
+                newBlockNeeded = true; // 새로운 블록 필요
+                break;
+            case 'p':
+                idxBlockDegree--;
+                if (idxBlockDegree < 0) {
+                    idxBlockDegree = MAX_BLK_DEGREES - 1;
+                }
+                currBlk = setOfBlockObjects[blockType][idxBlockDegree];
+                break;
+            case 'l':
+                idxBlockDegree++;
+                if (idxBlockDegree > MAX_BLK_DEGREES - 1) {
+                    idxBlockDegree = 0;
+                }
+                currBlk = setOfBlockObjects[blockType][idxBlockDegree];
+                break;
+            case 'w':
+                break;
+            case ' ':
+                top--;
+                newBlockNeeded = true; // 새로운 블록 필요
+                break;
+        }
+
+        // 사후처리 : 임시 백그라운드에 현재 블럭을 더해서 addedBlk를 만듬
+        probeBlock(iScreen, currBlk, top, left, &addedBlk);
+    }
+
+    compose();
+}
+
+// main()의 게임 루프 한 바퀴. 게임 오버면 false
+bool Tetris::step(char key) {
+    if (!lockBlock())
+        return false;
+    handleKey(key);
+    return true;
+}
+
+bool Tetris::save(const char *path) const {
+    SnapshotHeader state = {};
+    state.blockType = blockType;
+    state.blockDegree = idxBlockDegree;
+    state.pendingLock = newBlockNeeded;
+    state.top = top;
+    state.left = left;
+    state.rngSeed = rngSeed;
+    state.score = score;
+    return saveSnapshot(path, state, iScreen);
+}
+
+bool Tetris::load(const char *path) {
+    SnapshotFile snapshot;
+    if (!snapshot.open(path))
+        return false;
+    const SnapshotHeader *state = snapshot.get_header();
+    // 저장된 블럭이 화면 안에 있어야 probeBlock이 잘라낼 영역이 있음
+    if ((state->blockType >= MAX_BLK_TYPES) || (state->blockDegree >= MAX_BLK_DEGREES)) {
+        cerr << "invalid block in snapshot " << path << endl;
+        return false;
+    }
+    Matrix *blk = setOfBlockObjects[state->blockType][state->blockDegree];
+    if ((state->top < 0) || (state->left < 0) || (state->top + blk->get_dy() > iScreen->get_dy()) ||
+        (state->left + blk->get_dx() > iScreen->get_dx())) {
+        cerr << "block outside the screen in snapshot " << path << endl;
+        return false;
+    }
+    if (!snapshot.restore(iScreen))
+        return false;
+    blockType = state->blockType;
+    idxBlockDegree = state->blockDegree;
+    top = state->top;
+    left = state->left;
+    rngSeed = state->rngSeed;
+    score = state->score;
+    newBlockNeeded = state->pendingLock;
+    gameOver = false;
+    currBlk = setOfBlockObjects[blockType][idxBlockDegree];
+    probeBlock(iScreen, currBlk, top, left, &addedBlk);
+    compose();
+    return true;
+}
+
+// 되돌리기/다시하기: 기록된 판으로 돌아가 그때 나온 블럭을 처음 위치에서 다시 시작
+void Tetris::restore(const BoardVersion &version) {
+    version.board.toMatrix(iScreen);
+    blockType = version.blockType % MAX_BLK_TYPES;
+    idxBlockDegree = version.blockDegree % MAX_BLK_DEGREES;
+    top = INIT_TOP;
+    left = INIT_LEFT;
+    rngSeed = version.rngSeed;
+    score = version.score;
+    nBlocks = version.nBlocks;
+    newBlockNeeded = false;
+    gameOver = false;
+    currBlk = setOfBlockObjects[blockType][idxBlockDegree];
+    probeBlock(iScreen, currBlk, top, left, &addedBlk);
+    compose();
+}
+
+Matrix *Tetris::get_iScreen() const { return iScreen; }
+
+Matrix *Tetris::get_oScreen() const { return oScreen; }
+
+Matrix *Tetris::get_currBlk() const { return currBlk; }
+
+int Tetris::get_top() const { return top; }
+
+int Tetris::get_left() const { return left; }
+
+int Tetris::get_blockType() const { return blockType; }
+
+int Tetris::get_idxBlockDegree() const { return idxBlockDegree; }
+
+int Tetris::get_score() const { return score; }
+
+int Tetris::get_nBlocks() const { return nBlocks; }
+
+bool Tetris::isNewBlockNeeded() const { return newBlockNeeded; }
+
+bool Tetris::isGameOver() const { return gameOver; }
+
+unsigned int Tetris::get_rngSeed() const { return rngSeed; }
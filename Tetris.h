@@ -0,0 +1,77 @@
+#pragma once
+#include "Matrix.h"
+#include "Persistent.h"
+
+/**************************************************************/
+/****************** Tetris Game Definitions *******************/
+/**************************************************************/
+#define MAX_BLK_TYPES 7
+#define MAX_BLK_DEGREES 4
+
+#define SCREEN_DY  10
+#define SCREEN_DX  10
+#define SCREEN_DW  4
+
+#define ARRAY_DY (SCREEN_DY + SCREEN_DW)
+#define ARRAY_DX (SCREEN_DX + 2*SCREEN_DW)
+
+#define INIT_TOP 0
+#define INIT_LEFT 8
+
+extern int *setOfBlockArrays[];
+extern int arrayScreen[ARRAY_DY][ARRAY_DX];
+
+int getSideLength(int arr[]);
+void createBlockObjects(Matrix *setOfBlockObjects[MAX_BLK_TYPES][MAX_BLK_DEGREES]);
+void deriveRotations(Matrix *base, Matrix *rotations[MAX_BLK_DEGREES]);
+bool loadBlockObjects(const char *path, Matrix *setOfBlockObjects[MAX_BLK_TYPES][MAX_BLK_DEGREES]);
+void deleteBlockObjects(Matrix *setOfBlockObjects[MAX_BLK_TYPES][MAX_BLK_DEGREES]);
+int deleteFullLines(Matrix *gameMap, int top, int left, int blockHeight);
+bool checkIsTouchedTop(Matrix *gameMap);
+bool probeBlock(Matrix *screen, Matrix *blk, int top, int left, Matrix **addedBlk);
+bool collides(Matrix *screen, Matrix *blk, int top, int left);
+const char *cellSymbol(int value);
+void drawScreen(Matrix *screen, int wall_depth);
+
+// One game, stepped one key at a time exactly like the loop in main().
+// The block objects are shared between games and are not owned.
+class Tetris {
+private:
+    Matrix *(*setOfBlockObjects)[MAX_BLK_DEGREES];
+    Matrix *iScreen;
+    Matrix *oScreen;
+    Matrix *currBlk;
+    Matrix *addedBlk;
+    int top;
+    int left;
+    int blockType;
+    int idxBlockDegree;
+    int score;
+    int nBlocks;
+    bool newBlockNeeded;
+    bool gameOver;
+    bool verbose;
+    unsigned int rngSeed;
+    void compose();
+public:
+    Tetris(Matrix *setOfBlockObjects[MAX_BLK_TYPES][MAX_BLK_DEGREES], unsigned int seed, bool verbose);
+    ~Tetris();
+    bool lockBlock();
+    void handleKey(char key);
+    bool step(char key);
+    bool save(const char *path) const;
+    bool load(const char *path);
+    void restore(const BoardVersion &version);
+    Matrix *get_iScreen() const;
+    Matrix *get_oScreen() const;
+    Matrix *get_currBlk() const;
+    int get_top() const;
+    int get_left() const;
+    int get_blockType() const;
+    int get_idxBlockDegree() const;
+    int get_score() const;
+    int get_nBlocks() const;
+    bool isNewBlockNeeded() const;
+    bool isGameOver() const;
+    unsigned int get_rngSeed() const;
+};
@@ -0,0 +1,192 @@
+#include <chrono>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include "TileRenderer.h"
+
+TileRenderer::TileRenderer() {
+  symbol = NULL;
+  nTiles = 0;
+  wallDepth = 0;
+  columns = 1;
+  rowsShown = 0;
+  colsShown = 0;
+  tiles = NULL;
+  shown = NULL;
+  cleared = false;
+  statusChanged = false;
+  running.store(false);
+  refreshMs = MIN_REFRESH_MS;
+  writeMs = 0;
+  nRefreshes = 0;
+  nBytes = 0;
+  nDropped = 0;
+}
+
+TileRenderer::~TileRenderer() { stop(); }
+
+bool TileRenderer::start(int nTiles, int cy, int cx, int wall_depth, int columns, const char *(*symbol)(int value)) {
+  if (running.load() || (nTiles <= 0)) return false;
+  this->symbol = symbol;
+  this->nTiles = nTiles;
+  wallDepth = wall_depth;
+  // the same region as drawScreen: the floor and one column of each side wall
+  rowsShown = cy - wall_depth + 1;
+  colsShown = cx - 2 * wall_depth + 2;
+  if (columns <= 0) {
+    struct winsize ws;
+    int width = 80;
+    if ((ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0) && (ws.ws_col > 0))
+      width = ws.ws_col;
+    columns = width / (2 * colsShown + 1);
+  }
+  this->columns = max(1, min(columns, nTiles));
+
+  tiles = new TripleBuffer*[nTiles];
+  shown = new Matrix*[nTiles];
+  for (int i = 0; i < nTiles; i++) {
+    tiles[i] = new TripleBuffer(cy, cx);
+    shown[i] = new Matrix(cy, cx, -1);   // matches no cell, so the first frame is drawn whole
+  }
+  cleared = false;
+  statusChanged = false;
+  refreshMs = MIN_REFRESH_MS;
+  writeMs = 0;
+  nRefreshes = 0;
+  nBytes = 0;
+  nDropped = 0;
+  running.store(true);
+  thread = std::thread(&TileRenderer::loop, this);
+  return true;
+}
+
+bool TileRenderer::isRunning() const { return running.load(); }
+
+// one producer per tile; never waits
+void TileRenderer::submit(int tile, const Matrix *screen) {
+  if ((tile < 0) || (tile >= nTiles)) return;
+  tiles[tile]->publish(screen);
+}
+
+void TileRenderer::setStatus(const std::string &line) {
+  std::lock_guard<std::mutex> lock(mutex);
+  status = line;
+  statusChanged = true;
+}
+
+void TileRenderer::loop() {
+  while (running.load(std::memory_order_acquire)) {
+    refresh();
+    std::unique_lock<std::mutex> lock(mutex);
+    wakeup.wait_for(lock, std::chrono::microseconds((long) (refreshMs * 1000)));
+  }
+  refresh();   // the last frames
+}
+
+// rows and columns of the terminal are 1-based; each cell is two columns wide
+void TileRenderer::moveTo(std::string &out, int row, int col) {
+  out += "\x1b[";
+  out += std::to_string(row);
+  out += ';';
+  out += std::to_string(col);
+  out += 'H';
+}
+
+void TileRenderer::refresh() {
+  std::string out;
+  int tileHeight = rowsShown + 1;       // the title row
+  int tileWidth = 2 * colsShown + 1;    // a blank column between tiles
+  int gridRows = (nTiles + columns - 1) / columns;
+
+  if (!cleared) {
+    out += "\x1b[?25l\x1b[2J";
+    for (int i = 0; i < nTiles; i++) {
+      moveTo(out, (i / columns) * tileHeight + 1, (i % columns) * tileWidth + 1);
+      out += "#" + std::to_string(i);
+    }
+    cleared = true;
+  }
+
+  for (int i = 0; i < nTiles; i++) {
+    Matrix *frame = tiles[i]->acquire();
+    if (frame == NULL) continue;
+    int **f_array = frame->get_array();
+    int **s_array = shown[i]->get_array();
+    int top = (i / columns) * tileHeight + 2;
+    int left = (i % columns) * tileWidth + 1;
+    for (int y = 0; y < rowsShown; y++) {
+      int next = -1;   // column the cursor sits at after the last cell written
+      for (int c = 0; c < colsShown; c++) {
+        int x = wallDepth - 1 + c;
+        if (f_array[y][x] == s_array[y][x]) continue;
+        if (c != next)
+          moveTo(out, top + y, left + 2 * c);
+        out += symbol(f_array[y][x]);
+        s_array[y][x] = f_array[y][x];
+        next = c + 1;
+      }
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (statusChanged) {
+      moveTo(out, gridRows * tileHeight + 1, 1);
+      out += status;
+      out += "\x1b[K";
+      statusChanged = false;
+    }
+  }
+  if (!running.load(std::memory_order_relaxed)) {
+    moveTo(out, gridRows * tileHeight + 2, 1);
+    out += "\x1b[?25h";
+  }
+  if (out.empty()) return;
+
+  auto begin = std::chrono::steady_clock::now();
+  size_t done = 0;
+  while (done < out.size()) {
+    ssize_t n = write(STDOUT_FILENO, out.data() + done, out.size() - done);
+    if (n <= 0) break;
+    done += n;
+  }
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+  nRefreshes++;
+  nBytes += done;
+
+  // spend at most about a quarter of the time writing
+  writeMs = (nRefreshes == 1) ? ms : 0.8 * writeMs + 0.2 * ms;
+  refreshMs = max((double) MIN_REFRESH_MS, min((double) MAX_REFRESH_MS, 4 * writeMs));
+}
+
+// Draws what was submitted last, then joins the render thread.
+void TileRenderer::stop() {
+  if (!running.load()) return;
+  running.store(false, std::memory_order_release);
+  wakeup.notify_one();
+  thread.join();
+  nDropped = get_nDropped();
+  for (int i = 0; i < nTiles; i++) {
+    delete tiles[i];
+    delete shown[i];
+  }
+  delete[] tiles;
+  delete[] shown;
+  tiles = NULL;
+  shown = NULL;
+}
+
+int TileRenderer::get_nTiles() const { return nTiles; }
+
+unsigned long TileRenderer::get_nRefreshes() const { return nRefreshes; }
+
+unsigned long TileRenderer::get_nBytes() const { return nBytes; }
+
+unsigned long TileRenderer::get_nDropped() const {
+  if (tiles == NULL) return nDropped;
+  unsigned long total = 0;
+  for (int i = 0; i < nTiles; i++)
+    total += tiles[i]->get_nDropped();
+  return total;
+}
+
+int TileRenderer::get_refreshMs() const { return (int) refreshMs; }
@@ -0,0 +1,58 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "Matrix.h"
+#include "Renderer.h"
+
+// Draws many boards at once, tiled in a grid on one terminal.
+// Every board has its own TripleBuffer, so the games publish frames without
+// ever waiting for the terminal. The render thread wakes once per refresh,
+// takes the tiles that have a new frame, and sends only the cells that
+// differ from what is on screen, with cursor moves, in a single write().
+// The refresh interval follows how long those writes take: a slow terminal
+// gets fewer, larger updates instead of a growing backlog.
+class TileRenderer {
+private:
+  static const int MIN_REFRESH_MS = 16;
+  static const int MAX_REFRESH_MS = 1000;
+  const char *(*symbol)(int value);
+  int nTiles;
+  int wallDepth;
+  int columns;          // tiles per grid row
+  int rowsShown;        // board rows drawn per tile, floor included
+  int colsShown;        // board columns drawn per tile, side walls included
+  TripleBuffer **tiles;
+  Matrix **shown;       // what the terminal shows now, per tile
+  bool cleared;
+  std::string status;   // one line under the grid
+  bool statusChanged;
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable wakeup;
+  std::atomic<bool> running;
+  double refreshMs;
+  double writeMs;       // moving average of the time spent in write()
+  unsigned long nRefreshes;
+  unsigned long nBytes;
+  unsigned long nDropped;
+  void loop();
+  void refresh();
+  void moveTo(std::string &out, int row, int col);
+public:
+  TileRenderer();
+  ~TileRenderer();
+  // columns <= 0 fits as many tiles per row as the terminal is wide
+  bool start(int nTiles, int cy, int cx, int wall_depth, int columns, const char *(*symbol)(int value));
+  bool isRunning() const;
+  void submit(int tile, const Matrix *screen);
+  void setStatus(const std::string &line);
+  void stop();
+  int get_nTiles() const;
+  unsigned long get_nRefreshes() const;
+  unsigned long get_nBytes() const;
+  unsigned long get_nDropped() const;
+  int get_refreshMs() const;
+};
@@ -0,0 +1,154 @@
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <chrono>
+#include <iostream>
+
+#include "Trace.h"
+
+/**************************************************************/
+/*********************** TraceBuffer **************************/
+/**************************************************************/
+
+TraceBuffer::TraceBuffer(int tid) {
+  this->tid = tid;
+  head.store(0);
+  tail.store(0);
+  nDropped = 0;
+}
+
+void TraceBuffer::push(const TraceEvent &event) {
+  uint32_t h = head.load(memory_order_relaxed);
+  if (h - tail.load(memory_order_acquire) >= TRACE_BUFFER_SIZE) {
+    nDropped++;   // the flusher fell behind; losing an event beats blocking
+    return;
+  }
+  events[h % TRACE_BUFFER_SIZE] = event;
+  head.store(h + 1, memory_order_release);
+}
+
+/**************************************************************/
+/************************** Trace *****************************/
+/**************************************************************/
+
+std::atomic<bool> Trace::enabled(false);
+std::atomic<bool> Trace::running(false);
+FILE *Trace::fp = NULL;
+bool Trace::first = true;
+int Trace::pid = 0;
+uint64_t Trace::epoch = 0;
+std::mutex Trace::registry;
+vector<TraceBuffer *> Trace::buffers;
+std::thread Trace::flusher;
+
+uint64_t Trace::now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec - epoch;
+}
+
+bool Trace::open(const char *path) {
+  if (enabled.load()) return false;
+  fp = fopen(path, "w");
+  if (fp == NULL) {
+    cerr << "cannot open trace file " << path << endl;
+    return false;
+  }
+  fprintf(fp, "{\"traceEvents\":[\n");
+  first = true;
+  pid = getpid();
+  epoch = 0;
+  epoch = now();
+  running.store(true);
+  flusher = std::thread(flushLoop);
+  enabled.store(true, memory_order_release);
+  return true;
+}
+
+bool Trace::isEnabled() { return enabled.load(memory_order_relaxed); }
+
+TraceBuffer *Trace::threadBuffer() {
+  static thread_local TraceBuffer *buffer = NULL;
+  if (buffer == NULL) {
+    buffer = new TraceBuffer(syscall(SYS_gettid));
+    lock_guard<std::mutex> lock(registry);
+    buffers.push_back(buffer);
+  }
+  return buffer;
+}
+
+void Trace::complete(const char *name, uint64_t begin, uint64_t end) {
+  TraceEvent event = { name, 'X', begin, end - begin, 0 };
+  threadBuffer()->push(event);
+}
+
+void Trace::counter(const char *name, int64_t value) {
+  if (!isEnabled()) return;
+  TraceEvent event = { name, 'C', now(), 0, value };
+  threadBuffer()->push(event);
+}
+
+void Trace::flush() {
+  lock_guard<std::mutex> lock(registry);
+  for (size_t i = 0; i < buffers.size(); i++) {
+    TraceBuffer *b = buffers[i];
+    uint32_t t = b->tail.load(memory_order_relaxed);
+    uint32_t h = b->head.load(memory_order_acquire);
+    for (; t != h; t++) {
+      const TraceEvent &e = b->events[t % TRACE_BUFFER_SIZE];
+      fprintf(fp, first ? "" : ",\n");
+      first = false;
+      if (e.phase == 'X')
+        fprintf(fp, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                e.name, pid, b->tid, e.ts / 1000.0, e.dur / 1000.0);
+      else
+        fprintf(fp, "{\"name\":\"%s\",\"ph\":\"C\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"args\":{\"value\":%lld}}",
+                e.name, pid, b->tid, e.ts / 1000.0, (long long) e.value);
+    }
+    b->tail.store(t, memory_order_release);
+  }
+}
+
+void Trace::flushLoop() {
+  while (running.load(memory_order_acquire)) {
+    this_thread::sleep_for(chrono::milliseconds(TRACE_FLUSH_MS));
+    flush();
+  }
+}
+
+void Trace::close() {
+  if (!enabled.load()) return;
+  enabled.store(false, memory_order_release);
+  running.store(false, memory_order_release);
+  flusher.join();
+  flush();
+  fprintf(fp, "\n]}\n");
+  fclose(fp);
+  fp = NULL;
+
+  uint64_t nDropped = 0;
+  for (size_t i = 0; i < buffers.size(); i++)
+    nDropped += buffers[i]->nDropped;
+  if (nDropped > 0)
+    cerr << "trace: " << nDropped << " events dropped" << endl;
+  // thread_local pointers may still refer to the buffers, so they stay allocated
+}
+
+/**************************************************************/
+/************************ TraceSpan ***************************/
+/**************************************************************/
+
+TraceSpan::TraceSpan(const char *name) {
+  this->name = name;
+  ended = !Trace::isEnabled();
+  begin = ended ? 0 : Trace::now();
+}
+
+TraceSpan::~TraceSpan() { end(); }
+
+void TraceSpan::end() {
+  if (ended) return;
+  ended = true;
+  if (Trace::isEnabled())
+    Trace::complete(name, begin, Trace::now());
+}
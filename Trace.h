@@ -0,0 +1,72 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Chrome/Perfetto trace-event export.
+// Every thread records into its own single-producer ring, and a background
+// thread drains the rings into the JSON file, so recording an event never
+// takes a lock or touches the file. Event names must be string literals.
+// Open the resulting file in chrome://tracing or ui.perfetto.dev.
+
+#define TRACE_BUFFER_SIZE 16384
+#define TRACE_FLUSH_MS 50
+
+struct TraceEvent {
+  const char *name;
+  char phase;       // 'X' complete span, 'C' counter
+  uint64_t ts;      // ns since Trace::open
+  uint64_t dur;
+  int64_t value;
+};
+
+class TraceBuffer {
+public:
+  int tid;
+  std::atomic<uint32_t> head;   // written by the owning thread
+  std::atomic<uint32_t> tail;   // written by the flusher
+  uint64_t nDropped;
+  TraceEvent events[TRACE_BUFFER_SIZE];
+  TraceBuffer(int tid);
+  void push(const TraceEvent &event);
+};
+
+class Trace {
+private:
+  static std::atomic<bool> enabled;
+  static std::atomic<bool> running;
+  static FILE *fp;
+  static bool first;
+  static int pid;
+  static uint64_t epoch;
+  static std::mutex registry;
+  static vector<TraceBuffer *> buffers;
+  static std::thread flusher;
+  static TraceBuffer *threadBuffer();
+  static void flush();
+  static void flushLoop();
+public:
+  static bool open(const char *path);
+  static void close();
+  static bool isEnabled();
+  static uint64_t now();
+  static void complete(const char *name, uint64_t begin, uint64_t end);
+  static void counter(const char *name, int64_t value);
+};
+
+// Records its own lifetime, or up to end(), as one span.
+class TraceSpan {
+private:
+  const char *name;
+  uint64_t begin;
+  bool ended;
+public:
+  TraceSpan(const char *name);
+  ~TraceSpan();
+  void end();
+};
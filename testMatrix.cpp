@@ -1,6 +1,7 @@
 #include <iostream>
 #include <string>
 #include "Matrix.h"
+#include "MatrixExpr.h"
 
 using namespace std;
 
@@ -81,6 +82,118 @@ int main(int argc, char *argv[]) {
   cout << "tempBlk->anyGreaterThan(1)=" << tempBlk->anyGreaterThan(1) << endl;
   cout << "tempBlk2->anyGreaterThan(1)=" << tempBlk2->anyGreaterThan(1) << endl;
 
+  // the same steps through a view, without copying the region
+  MatrixView tempView = oScreen->view(top, left, top+currBlk->get_dy(), left+currBlk->get_dx());
+  cout << tempView;
+  cout << "tempView.sum()=" << tempView.sum() << endl;
+  cout << "tempView.anyGreaterThan(1)=" << tempView.anyGreaterThan(1) << endl;
+
+  Matrix *tempBlk3 = tempView.add(currBlk);
+  cout << "tempBlk3 (after view add):" << endl;
+  drawMatrix(tempBlk3); cout << endl;
+
+  oScreen->paste(oScreen->view(0, 0, 4, 12), 1, 0);
+  cout << "oScreen (after shifting rows 0..3 down by one):" << endl;
+  drawMatrix(oScreen); cout << endl;
+
+  // lazy expressions are evaluated in one pass without temporaries
+  int nAllocBefore = Matrix::get_nAlloc();
+  cout << "any(tempView + currBlk > 1)=" << any(lazy(tempView) + lazy(*currBlk) > 1) << endl;
+  cout << "sum(2 * currBlk)=" << sum(2 * lazy(*currBlk)) << endl;
+  cout << "sum(int2bool(tempBlk2 * 3))=" << sum(int2bool(lazy(*tempBlk2) * 3)) << endl;
+  cout << "allocations during lazy evaluation=" << Matrix::get_nAlloc() - nAllocBefore << endl;
+  cout << "any(invalid view + currBlk > 1)=" << any(lazy(oScreen->view(4, 10, 7, 13)) + lazy(*currBlk) > 1) << endl;
+  *tempBlk3 = lazy(*tempBlk) + lazy(*currBlk) * 2;
+  cout << "tempBlk3 (after tempBlk + currBlk * 2):" << endl;
+  tempBlk3->print(); cout << endl;
+  *tempBlk3 = lazy(tempBlk3->view(1, 0, 3, 2)) * 10;
+  cout << "tempBlk3 (after its own 2x2 corner * 10):" << endl;
+  tempBlk3->print(); cout << endl;
+
+  // large matrices split their rows over the pool; results match the serial loops
+  Matrix big(1000, 700);
+  int **b_array = big.get_array();
+  for (int y = 0; y < 1000; y++)
+    for (int x = 0; x < 700; x++)
+      b_array[y][x] = (y * 31 + x * 17) % 5 - 1;
+  Matrix::setParallel(4, 0);
+  int serialSum = big.sum();
+  Matrix serialSq = big + big;
+  serialSq.mulc(3);
+  Matrix *serialBool = serialSq.int2bool();
+  Matrix::setParallel(4, 1);
+  Matrix bigCopy(big);
+  Matrix parallelSq = bigCopy + big;
+  parallelSq.mulc(3);
+  Matrix *parallelBool = parallelSq.int2bool();
+  cout << "big.sum()=" << big.sum() << " serial=" << serialSum << endl;
+  cout << "parallel (big + big) * 3 == serial: " << !any(int2bool(lazy(parallelSq) + lazy(serialSq) * -1)) << endl;
+  cout << "parallel int2bool == serial: " << !any(int2bool(lazy(*parallelBool) + lazy(*serialBool) * -1)) << endl;
+  cout << "big.view(500, 0, 1000, 700).sum()=" << big.view(500, 0, 1000, 700).sum() << endl;
+  cout << "big.anyGreaterThan(1)=" << big.anyGreaterThan(1) << endl;
+  cout << "big.anyGreaterThan(3)=" << big.anyGreaterThan(3) << endl;
+  Matrix::setParallel(0, MATRIX_PARALLEL_MIN_CELLS);
+  delete serialBool;
+  delete parallelBool;
+
+  // quarter turns, mirror and transpose, out of place and in place
+  int arrayL[2][3] = {
+    { 1, 0, 0 },
+    { 1, 1, 1 },
+  };
+  Matrix *blkL = new Matrix((int *) arrayL, 2, 3);
+  Matrix *turned = blkL->rotate90();
+  cout << "rotate90:" << endl;
+  turned->print(); cout << endl;
+  Matrix *turned180 = blkL->rotate180();
+  cout << "rotate180:" << endl;
+  turned180->print(); cout << endl;
+  Matrix *turned270 = blkL->rotate270();
+  cout << "rotate270:" << endl;
+  turned270->print(); cout << endl;
+  Matrix *mirrored = blkL->flip();
+  cout << "flip:" << endl;
+  mirrored->print(); cout << endl;
+  Matrix *transposed = blkL->transpose();
+  cout << "transpose:" << endl;
+  transposed->print(); cout << endl;
+  blkL->rotate90InPlace();
+  blkL->rotate90InPlace();
+  cout << "rotate90InPlace twice == rotate180: " << !any(int2bool(lazy(*blkL) + lazy(*turned180) * -1)) << endl;
+
+  // tiles of a matrix that is neither square nor a multiple of the tile size
+  Matrix *wide = new Matrix(70, 45);
+  int **w_array = wide->get_array();
+  for (int y = 0; y < 70; y++)
+    for (int x = 0; x < 45; x++)
+      w_array[y][x] = y * 100 + x;
+  Matrix wideOriginal(wide);
+  Matrix *wide270 = wide->rotate270();
+  Matrix square(big.view(0, 0, 100, 100));
+  Matrix *square90 = square.rotate90();
+  wide->rotate90InPlace();
+  wide->rotate180InPlace();
+  square.rotate90InPlace();
+  cout << "rotate90InPlace + rotate180InPlace == rotate270: " << !any(int2bool(lazy(*wide) + lazy(*wide270) * -1))
+       << endl;
+  cout << "square rotate90InPlace == rotate90: " << !any(int2bool(lazy(square) + lazy(*square90) * -1)) << endl;
+  wide->transposeInPlace();
+  wide->flipInPlace();
+  square.rotate270InPlace();
+  cout << "rotate270 + transpose + flip == original: " << !any(int2bool(lazy(*wide) + lazy(wideOriginal) * -1))
+       << endl;
+  cout << "square rotate270InPlace undoes rotate90: " << !any(int2bool(lazy(square) + lazy(big.view(0, 0, 100, 100)) * -1))
+       << endl;
+  delete blkL;
+  delete turned;
+  delete turned180;
+  delete turned270;
+  delete mirrored;
+  delete transposed;
+  delete wide;
+  delete wide270;
+  delete square90;
+
   cout << "nAlloc=" << Matrix::get_nAlloc() << endl;
   cout << "nFree=" << Matrix::get_nFree() << endl;
   return 0;
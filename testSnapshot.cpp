@@ -0,0 +1,72 @@
+#include <iostream>
+#include <cstdlib>
+#include <unistd.h>
+#include "Matrix.h"
+#include "Tetris.h"
+
+using namespace std;
+
+#define SNAPSHOT_PATH "testSnapshot.bin"
+#define KEYS "asdpl w"
+
+char randomKey(unsigned int *rng) { return KEYS[rand_r(rng) % (sizeof(KEYS) - 1)]; }
+
+bool sameScreen(const Matrix *a, const Matrix *b) {
+  int **a_array = a->get_array();
+  int **b_array = b->get_array();
+  for (int y = 0; y < a->get_dy(); y++)
+    for (int x = 0; x < a->get_dx(); x++)
+      if (min(a_array[y][x], 2) != min(b_array[y][x], 2))
+        return false;
+  return true;
+}
+
+bool sameGame(const Tetris &a, const Tetris &b) {
+  return (a.get_top() == b.get_top()) && (a.get_left() == b.get_left()) &&
+         (a.get_blockType() == b.get_blockType()) && (a.get_idxBlockDegree() == b.get_idxBlockDegree()) &&
+         (a.get_score() == b.get_score()) && (a.get_rngSeed() == b.get_rngSeed()) &&
+         (a.isNewBlockNeeded() == b.isNewBlockNeeded()) && (a.isGameOver() == b.isGameOver()) &&
+         sameScreen(a.get_iScreen(), b.get_iScreen()) && sameScreen(a.get_oScreen(), b.get_oScreen());
+}
+
+int main(int argc, char *argv[]) {
+  Matrix *setOfBlockObjects[MAX_BLK_TYPES][MAX_BLK_DEGREES];
+  createBlockObjects(setOfBlockObjects);
+
+  // play random keys until the board holds a 2+ cell, like real games can
+  Tetris *played = NULL;
+  unsigned int rng = 1;
+  for (unsigned int seed = 1; played == NULL; seed++) {
+    Tetris *game = new Tetris(setOfBlockObjects, seed, false);
+    for (int i = 0; (i < 2000) && !game->isGameOver(); i++) {
+      game->step(randomKey(&rng));
+      if (!game->isGameOver() && !game->isNewBlockNeeded() && game->get_iScreen()->anyGreaterThan(1)) {
+        played = game;
+        cout << "seed " << seed << ": a 2+ cell after " << i + 1 << " keys, score " << game->get_score() << endl;
+        break;
+      }
+    }
+    if (played == NULL)
+      delete game;
+  }
+
+  cout << "save=" << played->save(SNAPSHOT_PATH) << endl;
+  Tetris restored(setOfBlockObjects, 0, false);
+  cout << "load=" << restored.load(SNAPSHOT_PATH) << endl;
+  unlink(SNAPSHOT_PATH);
+  cout << "restored == played: " << sameGame(restored, *played) << endl;
+
+  // both go on with the same keys
+  int nSame = 0, nKeys = 500;
+  for (int i = 0; i < nKeys; i++) {
+    char key = randomKey(&rng);
+    played->step(key);
+    restored.step(key);
+    nSame += sameGame(restored, *played);
+  }
+  cout << "same after each of " << nKeys << " more keys: " << (nSame == nKeys) << endl;
+
+  delete played;
+  deleteBlockObjects(setOfBlockObjects);
+  return 0;
+}